@@ -0,0 +1,328 @@
+#include "bot.h"
+#include "cfr.h"
+#include "mcts.h"
+#include "metrics.h"
+#include "strength.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define MAX_SEATS 4
+#define DEFAULT_BOT_BUDGET_US 500
+// Off the render thread a decision can take much longer without dropping a
+// frame
+#define DEFAULT_ASYNC_BUDGET_US 20000
+// Bets move in the same steps as the bet slider
+#define BET_STEP 10
+// Extra equity wanted before calling off the whole stack
+#define ALL_IN_MARGIN 0.1
+
+typedef BotAction (*StrategyFunction)(const BotView *view, uint64_t deadline);
+
+static BotStrategy seat_strategies[MAX_SEATS] = {
+    EquityStrategy, EquityStrategy, EquityStrategy, EquityStrategy};
+static uint32_t bot_budget_us = DEFAULT_BOT_BUDGET_US;
+static uint32_t async_budget_us = DEFAULT_ASYNC_BUDGET_US;
+
+void set_bot_strategy(size_t seat, BotStrategy strategy) {
+  seat_strategies[seat] = strategy;
+}
+
+void set_bot_budget(uint32_t budget_us) { bot_budget_us = budget_us; }
+
+void set_bot_async_budget(uint32_t budget_us) { async_budget_us = budget_us; }
+
+BotAction calling_station(const BotView *view, uint64_t deadline) {
+  return (BotAction){BotCall, 0};
+}
+
+// xorshift64
+uint64_t next_bot_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Effective hand strength against the opponents' random hands, exact if it
+// is cached or can be computed within the budget, otherwise sampled until the
+// deadline. Sets `expired` if the deadline cut the sampling short
+float estimate_equity(const BotView *view, uint64_t deadline, bool *expired) {
+  return estimate_hand_strength(view->hole, view->board, view->board_count,
+                                view->opponents, deadline, expired)
+      .effective_strength;
+}
+
+// Fold when the equity does not cover the pot odds, bet when it is well above
+// an even share, otherwise call
+BotAction equity_strategy(const BotView *view, uint64_t deadline) {
+  bool expired = false;
+  float equity = estimate_equity(view, deadline, &expired);
+  if (expired)
+    metric_add(MetricBotBudgetExpired, 1);
+  float fair_share = 1.0 / (view->opponents + 1);
+
+  if (view->to_call > 0) {
+    float pot_odds = (float)view->to_call / (view->pot + view->to_call);
+    if (view->to_call >= view->stack)
+      pot_odds += ALL_IN_MARGIN;
+    if (equity < pot_odds)
+      return (BotAction){BotFold, 0};
+    // Only open the betting, so bots can not raise each other forever
+    return (BotAction){BotCall, 0};
+  }
+  if (equity > fair_share * 1.5) {
+    // Bet more of the pot the further ahead we are
+    float edge = (equity - fair_share) / (1.0 - fair_share);
+    int32_t amount = (int32_t)(view->pot * edge) / BET_STEP * BET_STEP;
+    if (amount < BET_STEP)
+      amount = BET_STEP;
+    if (amount > view->stack)
+      amount = view->stack;
+    if (amount > 0)
+      return (BotAction){BotBet, amount};
+  }
+  return (BotAction){BotCall, 0};
+}
+
+// Turn an abstract action into a move at the real table
+BotAction to_bot_action(const BotView *view, CfrAction action) {
+  switch (action) {
+  case CfrFold:
+    return (BotAction){BotFold, 0};
+  case CfrBetHalfPot:
+  case CfrBetPot: {
+    int32_t amount = cfr_bet_amount(action, view->pot, view->stack);
+    if (amount > 0)
+      return (BotAction){BotBet, amount};
+    break;
+  }
+  default:
+    break;
+  }
+  return (BotAction){BotCall, 0};
+}
+
+// Sample an action from the trained probabilities of the spot. Falls back to
+// the equity strategy when no strategy file is loaded
+BotAction cfr_strategy(const BotView *view, uint64_t deadline) {
+  size_t bucket = cfr_bucket(view->hole, view->board, view->board_count);
+  size_t infoset = cfr_infoset(view, bucket);
+  float probabilities[CFR_ACTION_COUNT];
+  if (!get_cfr_probabilities(infoset, probabilities))
+    return equity_strategy(view, deadline);
+  // Seeded by the spot, so the same spot plays the same way
+  uint64_t state = (infoset + 1) * 0x9E3779B97F4A7C15ull;
+  for (size_t i = 0; i < 2 + view->board_count; i++) {
+    Card card = i < 2 ? view->hole[i] : view->board[i - 2];
+    state = (state ^ card) * 0x100000001B3ull;
+  }
+  state = (state ^ view->pot) | 1;
+  float roll = (next_bot_random(&state) >> 40) / (float)(1 << 24);
+  CfrAction action = CfrCall;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    if (probabilities[i] > 0.0)
+      action = i;
+    if (roll < probabilities[i])
+      break;
+    roll -= probabilities[i];
+  }
+  return to_bot_action(view, action);
+}
+
+// Play the most visited action of a tree search, or the equity strategy if
+// another decision is using the search tree
+BotAction mcts_strategy(const BotView *view, uint64_t deadline) {
+  CfrAction action;
+  if (!search_mcts(view, deadline, &action))
+    return equity_strategy(view, deadline);
+  return to_bot_action(view, action);
+}
+
+static const StrategyFunction STRATEGIES[STRATEGY_COUNT] = {
+    [CallingStation] = calling_station,
+    [EquityStrategy] = equity_strategy,
+    [CfrStrategy] = cfr_strategy,
+    [MctsStrategy] = mcts_strategy,
+};
+
+BotAction decide_bot_action_by(size_t seat, const BotView *view,
+                               uint64_t deadline) {
+  uint64_t trace_start = trace_enabled ? trace_now() : 0;
+  uint64_t start = metrics_now();
+  BotAction action = STRATEGIES[seat_strategies[seat]](view, deadline);
+  uint64_t latency = metrics_now() - start;
+  metric_add(MetricBotDecisions, 1);
+  metric_add(MetricBotDecisionNanoseconds, latency);
+  metric_max(MetricBotDecisionMaxNanoseconds, latency);
+  if (trace_enabled)
+    trace_span("bot_decision", "bot", trace_start, trace_now(), "seat", seat,
+               "action", action.type);
+  return action;
+}
+
+BotAction decide_bot_action(size_t seat, const BotView *view) {
+  return decide_bot_action_by(seat, view,
+                              metrics_now() + bot_budget_us * 1000ull);
+}
+
+// Worker pool for asynchronous decisions. Each decision lives in a slot until
+// its result has been polled or it has been cancelled and finished. A ticket
+// is the slot index and the slot's generation, so a stale ticket never picks
+// up a later decision's result
+#define DECISION_SLOTS 16
+#define MAX_WORKERS 8
+
+typedef enum { SlotFree, SlotQueued, SlotRunning, SlotDone } SlotState;
+
+typedef struct {
+  SlotState state;
+  bool cancelled;
+  uint32_t generation;
+  size_t seat;
+  BotView view;
+  uint64_t deadline;
+  BotAction action;
+} DecisionSlot;
+
+BotTicket make_ticket(size_t slot, uint32_t generation) {
+  return generation << 8 | slot;
+}
+
+#ifndef _WIN32
+static DecisionSlot slots[DECISION_SLOTS] = {};
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[MAX_WORKERS];
+static size_t worker_count = 0;
+static bool workers_stopping = false;
+
+// Slot a ticket refers to, or NULL if the ticket is stale. Call with the pool
+// locked
+DecisionSlot *find_slot(BotTicket ticket) {
+  if (ticket == NO_BOT_TICKET)
+    return NULL;
+  DecisionSlot *slot = &slots[(ticket & 0xff) % DECISION_SLOTS];
+  if (slot->state == SlotFree || ticket >> 8 != slot->generation)
+    return NULL;
+  return slot;
+}
+
+void *run_bot_worker(void *arg) {
+  pthread_mutex_lock(&pool_lock);
+  while (!workers_stopping) {
+    DecisionSlot *slot = NULL;
+    for (size_t i = 0; i < DECISION_SLOTS && slot == NULL; i++) {
+      if (slots[i].state == SlotQueued)
+        slot = &slots[i];
+    }
+    if (slot == NULL) {
+      pthread_cond_wait(&pool_wake, &pool_lock);
+      continue;
+    }
+    if (slot->cancelled) {
+      slot->state = SlotFree;
+      continue;
+    }
+    slot->state = SlotRunning;
+    size_t seat = slot->seat;
+    BotView view = slot->view;
+    uint64_t deadline = slot->deadline;
+    pthread_mutex_unlock(&pool_lock);
+    BotAction action = decide_bot_action_by(seat, &view, deadline);
+    pthread_mutex_lock(&pool_lock);
+    // A cancelled decision has no one left to poll it
+    if (slot->cancelled) {
+      slot->state = SlotFree;
+    } else {
+      slot->action = action;
+      slot->state = SlotDone;
+    }
+  }
+  pthread_mutex_unlock(&pool_lock);
+  return NULL;
+}
+
+void start_bot_workers(size_t count) {
+  if (count > MAX_WORKERS)
+    count = MAX_WORKERS;
+  pthread_mutex_lock(&pool_lock);
+  workers_stopping = false;
+  pthread_mutex_unlock(&pool_lock);
+  while (worker_count < count &&
+         pthread_create(&workers[worker_count], NULL, run_bot_worker, NULL) ==
+             0)
+    worker_count += 1;
+}
+
+void stop_bot_workers() {
+  pthread_mutex_lock(&pool_lock);
+  workers_stopping = true;
+  pthread_cond_broadcast(&pool_wake);
+  pthread_mutex_unlock(&pool_lock);
+  for (size_t i = 0; i < worker_count; i++)
+    pthread_join(workers[i], NULL);
+  worker_count = 0;
+  // Nothing will run what is still queued
+  for (size_t i = 0; i < DECISION_SLOTS; i++)
+    slots[i].state = SlotFree;
+}
+
+BotTicket submit_bot_decision(size_t seat, const BotView *view) {
+  BotTicket ticket = NO_BOT_TICKET;
+  pthread_mutex_lock(&pool_lock);
+  for (size_t i = 0; i < DECISION_SLOTS && worker_count > 0; i++) {
+    DecisionSlot *slot = &slots[i];
+    if (slot->state != SlotFree)
+      continue;
+    slot->generation = (slot->generation + 1) & 0xffffff;
+    slot->state = SlotQueued;
+    slot->cancelled = false;
+    slot->seat = seat;
+    slot->view = *view;
+    slot->deadline = metrics_now() + async_budget_us * 1000ull;
+    ticket = make_ticket(i, slot->generation);
+    pthread_cond_signal(&pool_wake);
+    break;
+  }
+  pthread_mutex_unlock(&pool_lock);
+  return ticket;
+}
+
+bool poll_bot_decision(BotTicket ticket, BotAction *action) {
+  bool ready = false;
+  pthread_mutex_lock(&pool_lock);
+  DecisionSlot *slot = find_slot(ticket);
+  if (slot != NULL && slot->state == SlotDone && !slot->cancelled) {
+    *action = slot->action;
+    slot->state = SlotFree;
+    ready = true;
+  }
+  pthread_mutex_unlock(&pool_lock);
+  return ready;
+}
+
+void cancel_bot_decision(BotTicket ticket) {
+  pthread_mutex_lock(&pool_lock);
+  DecisionSlot *slot = find_slot(ticket);
+  if (slot != NULL) {
+    slot->cancelled = true;
+    // Queued and running decisions are freed by their worker
+    if (slot->state == SlotDone)
+      slot->state = SlotFree;
+  }
+  pthread_mutex_unlock(&pool_lock);
+}
+#else
+// No worker threads on Windows, decisions are made synchronously
+void start_bot_workers(size_t count) {}
+void stop_bot_workers() {}
+BotTicket submit_bot_decision(size_t seat, const BotView *view) {
+  return NO_BOT_TICKET;
+}
+bool poll_bot_decision(BotTicket ticket, BotAction *action) { return false; }
+void cancel_bot_decision(BotTicket ticket) {}
+#endif
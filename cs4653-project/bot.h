@@ -0,0 +1,82 @@
+#ifndef BOT_H
+#define BOT_H
+#include "cards.h"
+#include "rules.h"
+#include "stats.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bot decisions. A strategy looks at what one seat can see of the table and
+// picks fold, call or bet. Every decision has a time budget; strategies that
+// sample return their best answer so far once it runs out.
+
+typedef enum {
+  // Always calls
+  CallingStation,
+  // Compares equity against pot odds
+  EquityStrategy,
+  // Plays the strategy trained by the offline CFR solver, see cfr.h
+  CfrStrategy,
+  // Searches the rest of the hand with Monte Carlo tree search, see mcts.h
+  MctsStrategy,
+  STRATEGY_COUNT,
+} BotStrategy;
+
+typedef enum { BotFold, BotCall, BotBet } BotActionType;
+
+typedef struct {
+  BotActionType type;
+  // Amount to raise by, for BotBet
+  int32_t amount;
+} BotAction;
+
+// What a seat knows when it has to act
+typedef struct {
+  // Position at the table, seats act in order
+  size_t seat;
+  Card hole[2];
+  Card board[5];
+  size_t board_count;
+  // Money in the pot, the amount needed to call, and the seat's own money
+  int32_t pot;
+  int32_t to_call;
+  int32_t stack;
+  // Players still in the hand besides this seat
+  size_t opponents;
+  // Money, bets and folds of the whole table, for strategies that search
+  TableState table;
+  // How every seat has played over the recent hands
+  SeatStats stats[SEAT_COUNT];
+} BotView;
+
+void set_bot_strategy(size_t seat, BotStrategy strategy);
+// Default budget for each decision, in microseconds
+void set_bot_budget(uint32_t budget_us);
+// Decide for a seat within the default budget. Safe to call from any thread
+BotAction decide_bot_action(size_t seat, const BotView *view);
+// Decide with an explicit deadline, in metrics_now() nanoseconds
+BotAction decide_bot_action_by(size_t seat, const BotView *view,
+                               uint64_t deadline);
+
+// Asynchronous decisions. Decisions are queued to a pool of worker threads
+// and polled with the returned ticket, so a slow strategy never holds up a
+// frame. Without workers (or on Windows) submitting fails and the caller
+// should decide synchronously instead.
+typedef uint32_t BotTicket;
+#define NO_BOT_TICKET UINT32_MAX
+
+void start_bot_workers(size_t count);
+void stop_bot_workers();
+// Budget for each asynchronous decision, in microseconds
+void set_bot_async_budget(uint32_t budget_us);
+// Queue a decision, returns NO_BOT_TICKET if it could not be queued
+BotTicket submit_bot_decision(size_t seat, const BotView *view);
+// Whether the decision is ready. If it is, the ticket is used up and the
+// decision is written to `action`
+bool poll_bot_decision(BotTicket ticket, BotAction *action);
+// Give up on a decision, for example when the hand ends. Its result is
+// thrown away
+void cancel_bot_decision(BotTicket ticket);
+
+#endif
@@ -0,0 +1,167 @@
+#include "canonical.h"
+#include "subsets.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Faces as bits of a 13 bit mask, aces low
+#define FACE_BITS 13
+
+// Number of flops, C(52, 3)
+#define FLOP_COUNT 22100
+
+// Canonical index of every flop, by the rank of its cards. Built by the first
+// thread to ask for one, while any others wait for it
+static uint16_t flop_indices[FLOP_COUNT] = {};
+static atomic_bool flop_indices_ready = false;
+static atomic_bool flop_indices_building = false;
+
+void sort_cards(Card *cards, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    Card card = cards[i];
+    size_t j = i;
+    while (j > 0 && card_index(cards[j - 1]) > card_index(card)) {
+      cards[j] = cards[j - 1];
+      j--;
+    }
+    cards[j] = card;
+  }
+}
+
+void canonicalize_cards(const Card *hole, size_t hole_count, const Card *board,
+                        size_t board_count, Card *canonical_hole,
+                        Card *canonical_board) {
+  // Faces held by each suite: hole card faces in the high bits so they decide
+  // the order first, then board faces
+  uint32_t signatures[4] = {};
+  for (size_t i = 0; i < hole_count; i++) {
+    size_t suite = (get_suite(hole[i]) >> 8) - 1;
+    signatures[suite] |= 1u << (get_face(hole[i]) - Ace + FACE_BITS);
+  }
+  for (size_t i = 0; i < board_count; i++) {
+    size_t suite = (get_suite(board[i]) >> 8) - 1;
+    signatures[suite] |= 1u << (get_face(board[i]) - Ace);
+  }
+
+  // Order the suites by signature, largest first. Suites with the same
+  // signature hold the same faces, so their order does not matter
+  size_t order[4] = {0, 1, 2, 3};
+  for (size_t i = 1; i < 4; i++) {
+    size_t suite = order[i];
+    size_t j = i;
+    while (j > 0 && signatures[order[j - 1]] < signatures[suite]) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = suite;
+  }
+  Suite renamed[4];
+  for (size_t i = 0; i < 4; i++)
+    renamed[order[i]] = (i + 1) << 8;
+
+  for (size_t i = 0; i < hole_count; i++) {
+    size_t suite = (get_suite(hole[i]) >> 8) - 1;
+    canonical_hole[i] = new_card(get_face(hole[i]), renamed[suite]);
+  }
+  for (size_t i = 0; i < board_count; i++) {
+    size_t suite = (get_suite(board[i]) >> 8) - 1;
+    canonical_board[i] = new_card(get_face(board[i]), renamed[suite]);
+  }
+  sort_cards(canonical_hole, hole_count);
+  sort_cards(canonical_board, board_count);
+}
+
+void canonicalize(const Card hole[2], const Card *board, size_t board_count,
+                  Card canonical_hole[2], Card *canonical_board) {
+  canonicalize_cards(hole, 2, board, board_count, canonical_hole,
+                     canonical_board);
+}
+
+uint64_t canonical_key(const Card hole[2], const Card *board,
+                       size_t board_count) {
+  Card canonical_hole[2];
+  Card canonical_board[5];
+  canonicalize(hole, board, board_count, canonical_hole, canonical_board);
+  // Six bits per card in order, then the board size
+  uint64_t key = 0;
+  for (size_t i = 0; i < 2; i++)
+    key = key << 6 | card_index(canonical_hole[i]);
+  for (size_t i = 0; i < board_count; i++)
+    key = key << 6 | card_index(canonical_board[i]);
+  return key << 3 | board_count;
+}
+
+// Rows are the higher face and columns the lower for suited hands, the other
+// way around for offsuit hands, and pairs are on the diagonal
+size_t canonical_hole_index(const Card hole[2]) {
+  size_t first = get_face(hole[0]) - Ace;
+  size_t second = get_face(hole[1]) - Ace;
+  size_t high = first > second ? first : second;
+  size_t low = first > second ? second : first;
+  if (get_suite(hole[0]) == get_suite(hole[1]))
+    return high * FACE_BITS + low;
+  return low * FACE_BITS + high;
+}
+
+// The flop is canonicalized on its own, without hole cards
+uint64_t canonical_flop_mask(uint64_t flop_mask) {
+  Card flop[3];
+  size_t count = 0;
+  for (int i = 0; i < CARD_COUNT; i++) {
+    if (flop_mask & (1ull << i))
+      flop[count++] = index_card(i);
+  }
+  Card canonical_flop[3];
+  canonicalize_cards(NULL, 0, flop, 3, NULL, canonical_flop);
+  uint64_t mask = 0;
+  for (size_t i = 0; i < 3; i++)
+    mask |= 1ull << card_index(canonical_flop[i]);
+  return mask;
+}
+
+int compare_masks(const void *a, const void *b) {
+  uint64_t left = *(const uint64_t *)a;
+  uint64_t right = *(const uint64_t *)b;
+  return left < right ? -1 : left > right;
+}
+
+void build_flop_indices() {
+  // Sort the canonical forms of all flops, and number the distinct ones
+  static uint64_t masks[FLOP_COUNT];
+  for (uint64_t rank = 0; rank < FLOP_COUNT; rank++)
+    masks[rank] = canonical_flop_mask(unrank_subset(rank, 3));
+  static uint64_t sorted[FLOP_COUNT];
+  memcpy(sorted, masks, sizeof(sorted));
+  qsort(sorted, FLOP_COUNT, sizeof(uint64_t), compare_masks);
+  size_t distinct = 0;
+  for (size_t i = 0; i < FLOP_COUNT; i++) {
+    if (distinct == 0 || sorted[i] != sorted[distinct - 1])
+      sorted[distinct++] = sorted[i];
+  }
+  // Every flop's canonical form is one of the distinct ones
+  for (uint64_t rank = 0; rank < FLOP_COUNT; rank++) {
+    uint64_t *found = bsearch(&masks[rank], sorted, distinct,
+                              sizeof(uint64_t), compare_masks);
+    flop_indices[rank] = found - sorted;
+  }
+}
+
+size_t canonical_flop_index(const Card flop[3]) {
+  if (!atomic_load_explicit(&flop_indices_ready, memory_order_acquire)) {
+    while (atomic_exchange_explicit(&flop_indices_building, true,
+                                    memory_order_acquire))
+      ;
+    // Another thread may have built it while this one waited
+    if (!atomic_load_explicit(&flop_indices_ready, memory_order_relaxed)) {
+      build_flop_indices();
+      atomic_store_explicit(&flop_indices_ready, true, memory_order_release);
+    }
+    atomic_store_explicit(&flop_indices_building, false, memory_order_release);
+  }
+  uint64_t mask = 0;
+  for (size_t i = 0; i < 3; i++)
+    mask |= 1ull << card_index(flop[i]);
+  return flop_indices[rank_subset(mask)];
+}
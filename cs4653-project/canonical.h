@@ -0,0 +1,33 @@
+#ifndef CANONICAL_H
+#define CANONICAL_H
+#include "cards.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Suit isomorphism. Hands that only differ by a renaming of the suits play
+// the same, so they are mapped to one canonical form: the suits are sorted by
+// which faces they hold, hole cards first and then the board, and renamed to
+// Club, Spade, Diamond, Heart in that order. Tables and caches keyed on the
+// canonical form are an order of magnitude smaller.
+
+// Starting hands up to suit isomorphism, 13 pairs, 78 suited and 78 offsuit
+#define CANONICAL_HOLE_COUNT 169
+// Flops up to suit isomorphism, out of 22100
+#define CANONICAL_FLOP_COUNT 1755
+
+// Rename suits to the canonical form. The hole cards and the board are
+// each sorted by card_index() afterwards
+void canonicalize(const Card hole[2], const Card *board, size_t board_count,
+                  Card canonical_hole[2], Card *canonical_board);
+// Key that is the same for exactly the hole card and board sets that are
+// suit isomorphic, for cache lookups. `board_count` is 0 to 5
+uint64_t canonical_key(const Card hole[2], const Card *board,
+                       size_t board_count);
+// Dense index of a starting hand, 0 to CANONICAL_HOLE_COUNT - 1
+size_t canonical_hole_index(const Card hole[2]);
+// Dense index of a flop, 0 to CANONICAL_FLOP_COUNT - 1. The first call builds
+// a table of every flop, the calls after it are a lookup. Safe to call from
+// any thread
+size_t canonical_flop_index(const Card flop[3]);
+
+#endif
@@ -1,60 +1,76 @@
-#ifndef CARDS_H
-#define CARDS_H
-#include <stdint.h>
-#define CARD_COUNT 52
-
-typedef enum {
-  Ace = 1,
-  Two = 2,
-  Three = 3,
-  Four = 4,
-  Five = 5,
-  Six = 6,
-  Seven = 7,
-  Eight = 8,
-  Nine = 9,
-  Ten = 10,
-  Jack = 11,
-  Queen = 12,
-  King = 13,
-} Face;
-typedef enum {
-  Club = 1 << 8,
-  Spade = 2 << 8,
-  Diamond = 3 << 8,
-  Heart = 4 << 8,
-} Suite;
-// Cards are nullable, 0 does not represent a valid card
-typedef int16_t Card;
-typedef Card *Deck;
-
-extern Card face_values[CARD_COUNT];
-
-const extern Card BACKFACE;
-const extern Card JOKER_BLACK;
-const extern Card JOKER_RED;
-
-Card new_card(Face, Suite);
-Face get_face(Card);
-Suite get_suite(Card);
-void print_card(Card);
-void init_face_values();
-void shuffle_face_values();
-void print_deck(Deck);
-
-typedef enum {
-  HighCard = 1 << 8,
-  TwoKind = 2 << 8,
-  TwoPair = 3 << 8,
-  ThreeKind = 4 << 8,
-  Straight = 5 << 8,
-  Flush = 6 << 8,
-  FullHouse = 7 << 8,
-  FourKind = 8 << 8,
-  StraightFlush = 9 << 8,
-  RoyalFlush = 10 << 8,
-} HandRank;
-typedef uint16_t HandValue;
-HandValue evaluate_hand(Card hand[2], Card board[5]);
-char *hand_value_string(HandValue val);
-#endif
+#ifndef CARDS_H
+#define CARDS_H
+#include <stddef.h>
+#include <stdint.h>
+#define CARD_COUNT 52
+
+typedef enum {
+  Ace = 1,
+  Two = 2,
+  Three = 3,
+  Four = 4,
+  Five = 5,
+  Six = 6,
+  Seven = 7,
+  Eight = 8,
+  Nine = 9,
+  Ten = 10,
+  Jack = 11,
+  Queen = 12,
+  King = 13,
+} Face;
+typedef enum {
+  Club = 1 << 8,
+  Spade = 2 << 8,
+  Diamond = 3 << 8,
+  Heart = 4 << 8,
+} Suite;
+// Cards are nullable, 0 does not represent a valid card
+typedef int16_t Card;
+typedef Card *Deck;
+
+extern Card face_values[CARD_COUNT];
+
+const extern Card BACKFACE;
+const extern Card JOKER_BLACK;
+const extern Card JOKER_RED;
+
+Card new_card(Face, Suite);
+Face get_face(Card);
+Suite get_suite(Card);
+void print_card(Card);
+void init_face_values();
+void shuffle_face_values();
+void print_deck(Deck);
+// Position of a card in a sorted deck, clubs first, or -1 if it is not valid
+int card_index(Card);
+Card index_card(int index);
+
+// Hand values compare as plain integers, higher is better. The rank is in
+// bits 20 and up, below it up to 5 faces that break ties between hands of
+// that rank, 4 bits each from the top, with aces as 14. Pairs, trips and
+// quads list the faces of their sets first and then the kickers, so 22 with
+// an ace kicker is below KK. Unused faces are 0
+#define HAND_RANK_SHIFT 20
+typedef enum {
+  HighCard = 1 << HAND_RANK_SHIFT,
+  TwoKind = 2 << HAND_RANK_SHIFT,
+  TwoPair = 3 << HAND_RANK_SHIFT,
+  ThreeKind = 4 << HAND_RANK_SHIFT,
+  Straight = 5 << HAND_RANK_SHIFT,
+  Flush = 6 << HAND_RANK_SHIFT,
+  FullHouse = 7 << HAND_RANK_SHIFT,
+  FourKind = 8 << HAND_RANK_SHIFT,
+  StraightFlush = 9 << HAND_RANK_SHIFT,
+  RoyalFlush = 10 << HAND_RANK_SHIFT,
+} HandRank;
+typedef uint32_t HandValue;
+#define get_hand_rank(value) ((HandRank)((value) & ~0xfffffu))
+// Face of the `i`th tie breaker, 0 the highest, aces as 14
+#define get_hand_face(value, i) (((value) >> (16 - (i) * 4)) & 0xf)
+HandValue evaluate_hand(Card hand[2], Card board[5]);
+// Best 5 card hand out of `count` cards, at most 7. Fewer than 5 cards can
+// only make pairs, trips and quads
+HandValue evaluate_cards(Card *cards, size_t count);
+char *hand_value_string(HandValue val);
+#endif
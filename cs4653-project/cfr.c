@@ -0,0 +1,220 @@
+#include "cfr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bets move in the same steps as the bet slider
+#define BET_STEP 10
+// Highest Chen score in each preflop bucket but the last
+static const int CHEN_BUCKET_LIMITS[CFR_BUCKETS - 1] = {2, 4, 6, 7, 8, 9, 11};
+
+// Doubled Chen points by face, with aces as 14
+static const int HIGH_CARD_POINTS[15] = {0, 0,  2,  3,  4,  5,  6, 7,
+                                         8, 9, 10, 12, 14, 16, 20};
+
+static const uint8_t *strategy_data = NULL;
+static size_t strategy_size = 0;
+
+// Chen formula score of two hole cards, -1 to 20
+int chen_score(const Card hole[2]) {
+  int high = get_face(hole[0]) == Ace ? 14 : get_face(hole[0]);
+  int low = get_face(hole[1]) == Ace ? 14 : get_face(hole[1]);
+  if (low > high) {
+    int temp = high;
+    high = low;
+    low = temp;
+  }
+  // Points of the high card, doubled so half points stay integers. A pair
+  // doubles the points of one card, which undoes the doubling
+  int score = HIGH_CARD_POINTS[high];
+  if (high == low)
+    return score < 5 ? 5 : score;
+  if (get_suite(hole[0]) == get_suite(hole[1]))
+    score += 4;
+  int gap = high - low - 1;
+  static const int GAP_PENALTIES[5] = {0, 2, 4, 8, 10};
+  score -= GAP_PENALTIES[gap < 4 ? gap : 4];
+  if (gap <= 1 && high < Queen)
+    score += 2;
+  // Halves round up
+  return (score + 1) / 2;
+}
+
+size_t cfr_bucket(const Card hole[2], const Card *board, size_t board_count) {
+  if (board_count == 0) {
+    int score = chen_score(hole);
+    size_t bucket = 0;
+    while (bucket < CFR_BUCKETS - 1 && score > CHEN_BUCKET_LIMITS[bucket])
+      bucket++;
+    return bucket;
+  }
+  Card cards[7] = {hole[0], hole[1]};
+  for (size_t i = 0; i < board_count; i++)
+    cards[i + 2] = board[i];
+  HandValue value = evaluate_cards(cards, board_count + 2);
+  // Hands the board makes on its own are as good as nothing
+  if (value == evaluate_cards(cards + 2, board_count))
+    return 0;
+  switch (get_hand_rank(value)) {
+  case HighCard:
+    return 0;
+  case TwoKind:
+    // The pair's face, aces high
+    return get_hand_face(value, 0) >= Ten ? 2 : 1;
+  case TwoPair:
+    return 3;
+  case ThreeKind:
+    return 4;
+  case Straight:
+    return 5;
+  case Flush:
+    return 6;
+  default:
+    return 7;
+  }
+}
+
+size_t cfr_infoset(const BotView *view, size_t bucket) {
+  size_t street = view->board_count == 0 ? 0 : view->board_count - 2;
+  size_t situation = 0;
+  if (view->to_call > 0) {
+    float pot_odds = (float)view->to_call / (view->pot + view->to_call);
+    situation = pot_odds < 0.2 ? 1 : pot_odds < 0.35 ? 2 : 3;
+  }
+  size_t opponents = view->opponents < 1 ? 1
+                     : view->opponents > SEAT_COUNT - 1 ? SEAT_COUNT - 1
+                                                        : view->opponents;
+  return (((street * CFR_BUCKETS + bucket) * SEAT_COUNT + view->seat) *
+              CFR_SITUATIONS +
+          situation) *
+             (SEAT_COUNT - 1) +
+         opponents - 1;
+}
+
+bool cfr_action_legal(size_t infoset, CfrAction action) {
+  bool facing_bet = infoset / (SEAT_COUNT - 1) % CFR_SITUATIONS != 0;
+  if (facing_bet)
+    return action == CfrFold || action == CfrCall;
+  return action != CfrFold;
+}
+
+int32_t cfr_bet_amount(CfrAction action, int32_t pot, int32_t stack) {
+  int32_t amount = action == CfrBetPot ? pot : pot / 2;
+  amount = amount / BET_STEP * BET_STEP;
+  // With an empty pot the sizes still differ
+  int32_t minimum = action == CfrBetPot ? BET_STEP * 2 : BET_STEP;
+  if (amount < minimum)
+    amount = minimum;
+  return amount < stack ? amount : stack;
+}
+
+void apply_cfr_action(HandState *state, CfrAction action) {
+  TableState *table = &state->table;
+  size_t seat = state->seat;
+  int32_t chips = FOLD_CHIPS;
+  if (action == CfrCall) {
+    chips = resolve_call(table, seat);
+  } else if (action != CfrFold) {
+    int32_t amount =
+        cfr_bet_amount(action, table->money[POT], table->money[seat]);
+    chips = resolve_bet(table, seat, amount);
+    state->bet_made = true;
+  }
+  apply_chips(table, seat, chips);
+}
+
+// Check the header against this abstraction
+bool is_strategy_valid(const uint8_t *data, size_t size) {
+  const CfrHeader *header = (const CfrHeader *)data;
+  return size == sizeof(CfrHeader) + CFR_INFOSETS * CFR_ACTION_COUNT &&
+         header->magic == CFR_MAGIC && header->version == CFR_FORMAT_VERSION &&
+         header->infosets == CFR_INFOSETS &&
+         header->actions == CFR_ACTION_COUNT &&
+         header->buckets == CFR_BUCKETS;
+}
+
+#ifndef _WIN32
+bool load_cfr_strategy(const char *path) {
+  unload_cfr_strategy();
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+    data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the file is closed
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  if (!is_strategy_valid(data, info.st_size)) {
+    munmap(data, info.st_size);
+    return false;
+  }
+  strategy_data = data;
+  strategy_size = info.st_size;
+  return true;
+}
+
+void unload_cfr_strategy() {
+  if (strategy_data != NULL)
+    munmap((void *)strategy_data, strategy_size);
+  strategy_data = NULL;
+  strategy_size = 0;
+}
+#else
+// No mmap on Windows, the file is small enough to read into memory
+bool load_cfr_strategy(const char *path) {
+  unload_cfr_strategy();
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+  size_t size = sizeof(CfrHeader) + CFR_INFOSETS * CFR_ACTION_COUNT;
+  uint8_t *data = malloc(size + 1);
+  // Read one byte too many to notice a longer file
+  size_t read = fread(data, 1, size + 1, file);
+  fclose(file);
+  if (read != size || !is_strategy_valid(data, read)) {
+    free(data);
+    return false;
+  }
+  strategy_data = data;
+  strategy_size = size;
+  return true;
+}
+
+void unload_cfr_strategy() {
+  free((void *)strategy_data);
+  strategy_data = NULL;
+  strategy_size = 0;
+}
+#endif
+
+bool is_cfr_strategy_loaded() { return strategy_data != NULL; }
+
+bool get_cfr_probabilities(size_t infoset,
+                           float probabilities[CFR_ACTION_COUNT]) {
+  if (strategy_data == NULL)
+    return false;
+  const uint8_t *row =
+      strategy_data + sizeof(CfrHeader) + infoset * CFR_ACTION_COUNT;
+  float total = 0.0;
+  float legal = 0.0;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    total += row[i];
+    legal += cfr_action_legal(infoset, i);
+  }
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    // An information set the solver never reached plays uniformly
+    if (total > 0.0)
+      probabilities[i] = row[i] / total;
+    else
+      probabilities[i] = cfr_action_legal(infoset, i) / legal;
+  }
+  return true;
+}
@@ -0,0 +1,73 @@
+#ifndef CFR_H
+#define CFR_H
+#include "bot.h"
+#include "cards.h"
+#include "rules.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Abstracted version of the table that the offline CFR solver trains on, and
+// the strategy file it exports. Hands are grouped into buckets and bets into
+// a few sizes, so every decision maps to one of CFR_INFOSETS information
+// sets. The bots map the real table to the same information sets and look up
+// the trained action probabilities in the strategy file.
+//
+// In the abstract game each street allows one bet. The players before the
+// bettor then get one more turn to call or fold, like the bots that never
+// re-raise.
+
+#define CFR_STREETS STREET_COUNT
+#define CFR_BUCKETS 8
+// Nobody has bet yet, or facing a bet at one of three pot odds
+#define CFR_SITUATIONS 4
+#define CFR_INFOSETS                                                           \
+  (CFR_STREETS * CFR_BUCKETS * SEAT_COUNT * CFR_SITUATIONS * (SEAT_COUNT - 1))
+
+typedef enum {
+  CfrFold,
+  CfrCall,
+  // Half the pot and the whole pot, only when nobody has bet yet
+  CfrBetHalfPot,
+  CfrBetPot,
+  CFR_ACTION_COUNT,
+} CfrAction;
+
+// Strategy file: a header, then for every information set one byte per
+// action with the probability scaled to 0-255. The abstraction parameters
+// are stored so a file from a different abstraction is refused
+#define CFR_MAGIC 0x53524643 // "CFRS"
+#define CFR_FORMAT_VERSION 1
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t infosets;
+  uint32_t actions;
+  uint32_t buckets;
+  uint32_t iterations;
+} CfrHeader;
+
+// Bucket of a hand, 0 weakest to CFR_BUCKETS - 1 strongest. Preflop this is
+// the Chen score of the hole cards, after the flop the hand category and
+// whether the hole cards play
+size_t cfr_bucket(const Card hole[2], const Card *board, size_t board_count);
+// Information set of a decision, 0 to CFR_INFOSETS - 1
+size_t cfr_infoset(const BotView *view, size_t bucket);
+// Whether `action` can be taken in the information set's situation
+bool cfr_action_legal(size_t infoset, CfrAction action);
+// Chips to raise by for a bet action
+int32_t cfr_bet_amount(CfrAction action, int32_t pot, int32_t stack);
+// Take an abstract action for the seat to act, through the betting rules
+void apply_cfr_action(HandState *state, CfrAction action);
+
+// Map a strategy file into memory, replacing any loaded one. Returns false if
+// it can not be read or was made for another abstraction
+bool load_cfr_strategy(const char *path);
+void unload_cfr_strategy();
+bool is_cfr_strategy_loaded();
+// Action probabilities of an information set, summing to 1 over the legal
+// actions. Returns false if no strategy is loaded
+bool get_cfr_probabilities(size_t infoset,
+                           float probabilities[CFR_ACTION_COUNT]);
+
+#endif
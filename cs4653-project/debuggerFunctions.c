@@ -1,6 +1,17 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
 #include "debuggerFunctions.h"
+#include "gameloop.h"
+
+#ifdef _WIN32
 #include <windows.h>
+#include <stdio.h>
+#include <tlhelp32.h>
+#include <psapi.h>
+#include <winternl.h>
 #include <processthreadsapi.h>
+#pragma comment(lib, "ntdll.lib")
 
 // Function to check if a debugger is present
 void checkDebugger() {
@@ -126,6 +137,165 @@ bool checkDebuggerHandleScan() {
     return false;
 }
 
+DWORD WINAPI runIntegrityChecks(LPVOID param) {
+    checkDebugger();
+    // Exits the game itself if a debugger is found
+    checkDebuggerHandleScan();
+    post_integrity_result(0);
+    return 0;
+}
+
+void startIntegrityChecks() {
+    HANDLE thread = CreateThread(NULL, 0, runIntegrityChecks, NULL, 0, NULL);
+    if (thread) {
+        SetThreadPriority(thread, THREAD_PRIORITY_LOWEST);
+        CloseHandle(thread);
+    }
+}
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// CPU time a short fixed workload may take before it is treated as being
+// single stepped, and how many runs in a row must go over it
+#define TIMING_THRESHOLD_MS 250
+#define TIMING_RUNS 3
+
+// Returns the pid of the process tracing this one, or 0 if there is none
+long readTracerPid() {
+    FILE *status = fopen("/proc/self/status", "r");
+    if (!status) return 0;
+    char line[256];
+    long tracerPid = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, "TracerPid:", 10) == 0) {
+            tracerPid = strtol(line + 10, NULL, 10);
+            break;
+        }
+    }
+    fclose(status);
+    return tracerPid;
+}
+
+// Function to check if a debugger is present
+void checkDebugger() {
+    if (readTracerPid() != 0) {
+        printf("Debugger detected! Exiting game.\n");
+        exit(1); // Terminate the program if a debugger is detected
+    }
+}
+
+// Returns the Yama ptrace scope, or 0 if Yama is not enabled
+int readPtraceScope() {
+    FILE *file = fopen("/proc/sys/kernel/yama/ptrace_scope", "r");
+    if (!file) return 0;
+    int scope = 0;
+    if (fscanf(file, "%d", &scope) != 1) scope = 0;
+    fclose(file);
+    return scope;
+}
+
+// A forked child tries to attach to this process with ptrace. Only one tracer
+// can be attached at a time, so this fails if a debugger is already attached
+bool checkPtraceAttach() {
+    // Attaching is not allowed at all with these scopes, so failing to attach
+    // would not mean anything
+    if (readPtraceScope() >= 2) return false;
+
+    int ready[2];
+    if (pipe(ready) != 0) return false;
+    pid_t parent = getpid();
+    pid_t child = fork();
+    if (child < 0) {
+        close(ready[0]);
+        close(ready[1]);
+        return false;
+    }
+    if (child == 0) {
+        // Only async-signal-safe calls in the child
+        char byte;
+        close(ready[1]);
+        if (read(ready[0], &byte, 1) != 1) _exit(0);
+        if (ptrace(PTRACE_ATTACH, parent, NULL, NULL) != 0)
+            _exit(errno == EPERM ? 1 : 0);
+        waitpid(parent, NULL, __WALL);
+        ptrace(PTRACE_DETACH, parent, NULL, NULL);
+        _exit(0);
+    }
+    close(ready[0]);
+    // Yama only lets a child trace its parent if the parent allows it
+    prctl(PR_SET_PTRACER, child, 0, 0, 0);
+    if (write(ready[1], "x", 1) != 1) {
+        // The child exits without attaching when the pipe closes
+    }
+    close(ready[1]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    prctl(PR_SET_PTRACER, 0, 0, 0, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 1;
+}
+
+// CPU time of this thread only, so time spent waiting behind other work on
+// the host, which this low priority thread does a lot of, is not counted
+double timeWorkloadMs() {
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    volatile unsigned int sum = 0;
+    for (unsigned int i = 0; i < 1000000; i++) sum += i * i;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    return (end.tv_sec - start.tv_sec) * 1000.0 +
+        (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+// Single stepping traps into the kernel on every instruction, which makes a
+// short workload take far more CPU time than it should. Every run has to be
+// slow, one slow run is not enough
+bool checkTimingAnomaly() {
+    for (int run = 0; run < TIMING_RUNS; run++) {
+        if (timeWorkloadMs() <= TIMING_THRESHOLD_MS) return false;
+    }
+    return true;
+}
+
+void *runIntegrityChecks(void *arg) {
+    // Run below the game loop and everything else on the host
+    struct sched_param param = {0};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0)
+        setpriority(PRIO_PROCESS, 0, 19);
+
+    bool tampered = false;
+    if (readTracerPid() != 0) {
+        printf("Debugger detected: process is being traced\n");
+        tampered = true;
+    } else if (checkPtraceAttach()) {
+        printf("Debugger detected: could not attach to own process\n");
+        tampered = true;
+    } else if (checkTimingAnomaly()) {
+        printf("Abnormal delay detected!\n");
+        tampered = true;
+    }
+    post_integrity_result(tampered);
+    return NULL;
+}
+
+void startIntegrityChecks() {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, runIntegrityChecks, NULL) == 0)
+        pthread_detach(thread);
+}
+#endif
+
 void execute_anti_disassembly(void) {
 #if defined(_WIN32) && defined(__GNUC__)
     asm volatile (
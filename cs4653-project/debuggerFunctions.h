@@ -1,20 +1,12 @@
 #ifndef DEBUGGER_FUNCTIONS_H
 #define DEBUGGER_FUNCTIONS_H
 
-#include <windows.h>
-#include <stdio.h>
-#include <tlhelp32.h>
-#include <psapi.h>
-#include <winternl.h>
-#pragma comment(lib, "ntdll.lib")
-
 // Function to check if a debugger is present
 void checkDebugger();
 
-void checkTiming(DWORD startTime);
-
-// Function to check how many processes have a handle on the current process
-void checkDebuggerHandleScan();
+// Run the startup integrity checks on a low priority background thread. The
+// result is posted to the game loop once the checks finish
+void startIntegrityChecks();
 
 void execute_anti_disassembly(void);
 
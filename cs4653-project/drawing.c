@@ -1,390 +1,700 @@
-#include "drawing.h"
-#include "cards.h"
-#include <math.h>
-#include <raylib.h>
-#include <stddef.h>
-#include <stdio.h>
-
-#define EVENT_QUEUE_SIZE 256
-#define RAYGUI_IMPLEMENTATION
-#include "raygui.h"
-
-HandValue display_hand = 0;
-
-static RenderTexture2D canvas;
-
-static int init = 0;
-static Texture2D card_atlas;
-int is_caught = 0;
-
-void draw_card(Card card, Vector2 position, float rotation, float flip) {
-  if (card == 0 || init == 0)
-    return;
-  if (flip < 0.0) {
-    card = BACKFACE;
-    flip = -flip;
-  }
-
-  int face = get_face(card) - 1;
-  int suite = (get_suite(card) >> 8) - 1;
-
-  Rectangle src_rect = (Rectangle){.x = face * CARD_WIDTH,
-                                   .y = suite * CARD_HEIGHT,
-                                   .width = CARD_WIDTH,
-                                   .height = CARD_HEIGHT};
-  Rectangle dst_rect = (Rectangle){.x = position.x,
-                                   .y = position.y,
-                                   .width = CARD_WIDTH * flip,
-                                   .height = CARD_HEIGHT};
-  DrawTexturePro(
-      card_atlas, src_rect, dst_rect,
-      (Vector2){.x = CARD_WIDTH / 2.0 * flip, .y = CARD_HEIGHT / 2.0}, rotation,
-      RAYWHITE);
-}
-
-const Vector2 ZERO = {0, 0};
-const float FLIP_SPEED = 8.0;
-const float MOVE_SPEED = 4.0;
-const float ROTATE_SPEED = 6.0;
-
-// App state
-static float frame_time = 1.0 / 60.0;
-static float current_time = 0.0;
-// Game state
-static Vector2 card_positions[CARD_COUNT];
-static float card_rotations[CARD_COUNT];
-static float card_flips[CARD_COUNT];
-// Animation state
-static float animation_start[CARD_COUNT];
-static Vector2 card_old_positions[CARD_COUNT];
-static Vector2 card_new_positions[CARD_COUNT];
-static float card_old_rotations[CARD_COUNT];
-static float card_new_rotations[CARD_COUNT];
-static float card_old_flips[CARD_COUNT];
-static float card_new_flips[CARD_COUNT];
-
-static int32_t display_moneys[5] = {};
-static int32_t old_display_moneys[5] = {};
-static int32_t new_display_moneys[5] = {};
-static float money_animation_start[5] = {};
-
-// Animation event queue
-typedef struct {
-  size_t card;
-  Vector2 position;
-  float rotation;
-  float flip;
-} MoveEvent;
-typedef struct {
-  uint8_t tag;
-  union {
-    MoveEvent move;
-    float wait;
-    struct {
-      size_t wallet;
-      int16_t amount;
-    } money;
-  } variant;
-} Event;
-static Event event_queue[EVENT_QUEUE_SIZE];
-static size_t event_queue_start = 0;
-static size_t event_queue_end = 0;
-static float last_event_start = 0;
-
-const Vector2 DECK_POSITION = {(float)WORLD_WIDTH / 2 - 200,
-                               (float)WORLD_HEIGHT / 2};
-
-const Vector2 HAND_POSITIONS[4][2] = {
-    {{0, (float)WORLD_HEIGHT / 2 + CARD_WIDTH / 2},
-     {0, (float)WORLD_HEIGHT / 2 - CARD_WIDTH / 2}},
-
-    {{(float)WORLD_WIDTH / 2 + CARD_WIDTH / 2, 0},
-     {(float)WORLD_WIDTH / 2 - CARD_WIDTH / 2, 0}},
-
-    {{WORLD_WIDTH, (float)WORLD_HEIGHT / 2 + CARD_WIDTH / 2},
-     {WORLD_WIDTH, (float)WORLD_HEIGHT / 2 - CARD_WIDTH / 2}},
-
-    {{(float)WORLD_WIDTH / 2 + CARD_WIDTH / 2, WORLD_HEIGHT},
-     {(float)WORLD_WIDTH / 2 - CARD_WIDTH / 2, WORLD_HEIGHT}},
-};
-
-void init_drawing() {
-  SetConfigFlags(FLAG_WINDOW_RESIZABLE);
-  InitWindow(WORLD_WIDTH, WORLD_HEIGHT, "Hold'em");
-  SetWindowTitle("Rowdy Hold'em");
-  canvas = LoadRenderTexture(WORLD_WIDTH, WORLD_HEIGHT);
-  card_atlas = LoadTexture("res/cards_sheet.png");
-  for (int i = 0; i < CARD_COUNT; i++) {
-    card_positions[i] = card_old_positions[i] = card_new_positions[i] =
-        DECK_POSITION;
-    card_flips[i] = card_old_flips[i] = card_new_flips[i] = -1.0;
-    card_rotations[i] = card_old_rotations[i] = card_new_rotations[i] = 0;
-    animation_start[i] = GetTime();
-  }
-  last_event_start = GetTime();
-  frame_time = GetFrameTime();
-  current_time = GetTime();
-  init = 1;
-}
-
-float lerp_float(float start, float end, float delta, float speed,
-                 float degree) {
-  delta = pow((current_time - delta) * speed, degree);
-  if (delta > 1.0)
-    delta = 1.0;
-  if (delta < 0.0)
-    delta = 0.0;
-  return (start + (end - start) * (delta * delta));
-}
-Vector2 lerp_v2(Vector2 start, Vector2 end, float delta, float speed,
-                float degree) {
-  return (Vector2){lerp_float(start.x, end.x, delta, speed, degree),
-                   lerp_float(start.y, end.y, delta, speed, degree)};
-}
-
-void exec_now(size_t queue_position) {
-  switch (event_queue[queue_position].tag) {
-  case 0: {
-    MoveEvent ev = event_queue[queue_position].variant.move;
-    card_old_positions[ev.card] = card_new_positions[ev.card] =
-        card_positions[ev.card] = ev.position;
-
-    card_old_rotations[ev.card] = card_new_rotations[ev.card] =
-        card_rotations[ev.card] = ev.rotation;
-
-    card_old_flips[ev.card] = card_new_flips[ev.card] = card_flips[ev.card] =
-        ev.flip;
-    break;
-  }
-  case 1: {
-    break;
-  }
-  }
-}
-
-void queue_anim(Event e) {
-  event_queue_end += 1;
-  event_queue_end %= EVENT_QUEUE_SIZE;
-  if (event_queue_end == event_queue_start) {
-    exec_now(event_queue_start);
-    event_queue_start += 1;
-    event_queue_start %= EVENT_QUEUE_SIZE;
-  }
-  event_queue[event_queue_end] = e;
-}
-
-int is_animations_finished() { return event_queue_start == event_queue_end; }
-
-void queue_anim_move(size_t card, Vector2 position, float rotation,
-                     float flip) {
-  queue_anim((Event){.tag = 0,
-                     .variant.move = (MoveEvent){.card = card,
-                                                 .position = position,
-                                                 .rotation = rotation,
-                                                 .flip = flip}});
-}
-void flip_card(size_t card) {
-  queue_anim_move(card, card_new_positions[card], card_new_rotations[card],
-                  -card_flips[card]);
-}
-
-void queue_anim_money(size_t wallet, uint16_t new_amount) {
-  queue_anim((Event){.tag = 2, .variant.money = {wallet, new_amount}});
-};
-
-void queue_anim_wait(float time) {
-  queue_anim((Event){.tag = 1, .variant.wait = time});
-}
-
-void draw_text(char *text, Vector2 position, int font_size, Color color) {
-  Vector2 size = MeasureTextEx(GetFontDefault(), text, font_size, 4);
-  // Draw text
-  DrawTextEx(GetFontDefault(), text, position, font_size, 4, color);
-}
-
-void draw_text_centered(char *text, Vector2 position, int font_size,
-                        Color color) {
-  Vector2 size = MeasureTextEx(GetFontDefault(), text, font_size, 4);
-  position.x -= size.x / 2;
-  position.y -= size.y / 2;
-  // Draw text
-  DrawTextEx(GetFontDefault(), text, position, font_size, 4, color);
-}
-
-ButtonState button_choice = NoButton;
-
-float bet_spinner_value = 0;
-
-Rectangle window = {};
-
-void draw_caught() {
-  GuiSetStyle(DEFAULT, TEXT_SIZE, (int)(0.07 * window.height));
-  GuiSetStyle(DEFAULT, TEXT_SPACING, (4.0 / 640.0) * window.height);
-  GuiSetStyle(DEFAULT, TEXT_LINE_SPACING, (35.0 / 640.0) * window.height);
-  GuiSetStyle(DEFAULT, TEXTURE_FILTER_ANISOTROPIC_4X, 1);
-  Vector2 center = {window.x + (float)window.width * 0.5,
-                    window.y + (float)window.height * 0.5};
-  Vector2 size = {0.8 * (float)window.width, 0.8 * (float)window.height};
-  Rectangle bounds = {.x = center.x - size.x / 2,
-                      .y = center.y - size.y / 2,
-                      .width = size.x,
-                      .height = size.y};
-  GuiPanel(bounds, NULL);
-  GuiDrawText("You have been caught cheating!\nGet out of my casino!!!", bounds,
-              1, BLACK);
-}
-
-void draw_ui() {
-  GuiSetStyle(DEFAULT, TEXT_SIZE, (int)(0.04 * window.height));
-  GuiSetStyle(DEFAULT, TEXT_SPACING, (4.0 / 640.0) * window.height);
-  GuiSetStyle(DEFAULT, TEXT_LINE_SPACING, (20.0 / 640.0) * window.height);
-  GuiSetStyle(DEFAULT, TEXTURE_FILTER_ANISOTROPIC_4X, 1);
-  Vector2 center = {window.x + (float)window.width * 0.8,
-                    window.y + (float)window.height * 0.85};
-  Vector2 size = {0.3125 * window.width, 0.208 * window.height};
-  // Panel
-  Rectangle bounds = {.x = center.x - size.x / 2,
-                      .y = center.y - size.y / 2,
-                      .width = size.x,
-                      .height = size.y};
-  GuiPanel(bounds, NULL);
-  // Buttons
-  Rectangle bet_button_bounds = {.x = bounds.x,
-                                 .y = bounds.y,
-                                 .width = bounds.width / 3,
-                                 .height = bounds.height / 2};
-  if (GuiButton(bet_button_bounds, "BET"))
-    button_choice = BetButton;
-  Rectangle call_button_bounds = {.x = bounds.x + bounds.width / 3,
-                                  .y = bounds.y,
-                                  .width = bounds.width / 3,
-                                  .height = bounds.height / 2};
-  if (GuiButton(call_button_bounds, "CALL"))
-    button_choice = CallButton;
-  Rectangle fold_button_bounds = {.x = bounds.x + bounds.width / 3 * 2,
-                                  .y = bounds.y,
-                                  .width = bounds.width / 3,
-                                  .height = bounds.height / 2};
-  if (GuiButton(fold_button_bounds, "FOLD"))
-    button_choice = FoldButton;
-  // Slider
-  Rectangle slider_bounds = {bounds.x, bounds.y + bounds.height / 2.0,
-                             .width = bounds.width,
-                             .height = bounds.height / 2};
-  GuiSlider(slider_bounds, NULL, NULL, &bet_spinner_value, 0.0, 2000.0);
-  bet_spinner_value = roundf(bet_spinner_value / 10.0) * 10.0;
-  char buffer[64] = {};
-  snprintf(buffer, 64, "$%d", (int)bet_spinner_value);
-  GuiDrawText(buffer, slider_bounds, 1, BLACK);
-}
-
-void draw() {
-  current_time = GetTime();
-  // Process event queue
-  if (event_queue_start != event_queue_end) {
-    size_t current_index = (event_queue_start + 1) % EVENT_QUEUE_SIZE;
-    Event current_ev = event_queue[current_index];
-    switch (current_ev.tag) {
-    case 0: {
-      MoveEvent ev = current_ev.variant.move;
-      card_old_positions[ev.card] = card_positions[ev.card];
-      card_new_positions[ev.card] = ev.position;
-
-      card_old_rotations[ev.card] = card_rotations[ev.card];
-      card_new_rotations[ev.card] = ev.rotation;
-
-      card_old_flips[ev.card] = card_flips[ev.card];
-      card_new_flips[ev.card] = ev.flip;
-
-      animation_start[ev.card] = current_time;
-      event_queue_start = current_index;
-      last_event_start = current_time;
-      break;
-    }
-    case 1: {
-      float wait_time = current_ev.variant.wait;
-      if (last_event_start + wait_time <= current_time) {
-        event_queue_start = current_index;
-        last_event_start = current_time;
-      }
-      break;
-    }
-    case 2: {
-      uint16_t wallet = current_ev.variant.money.wallet;
-      uint16_t amount = current_ev.variant.money.amount;
-      old_display_moneys[wallet] = display_moneys[wallet];
-      new_display_moneys[wallet] = amount;
-      money_animation_start[wallet] = current_time;
-      event_queue_start = current_index;
-      last_event_start = current_time;
-      break;
-    }
-    }
-  }
-  // Card animations
-  for (int i = 0; i < CARD_COUNT; i++) {
-    card_flips[i] = lerp_float(card_old_flips[i], card_new_flips[i],
-                               animation_start[i], FLIP_SPEED, 1);
-    card_positions[i] = lerp_v2(card_old_positions[i], card_new_positions[i],
-                                animation_start[i], MOVE_SPEED, 0.5);
-    card_rotations[i] = lerp_float(card_old_rotations[i], card_new_rotations[i],
-                                   animation_start[i], ROTATE_SPEED, 0.25);
-  }
-  // Money animations
-  for (int i = 0; i < 5; i++) {
-    display_moneys[i] =
-        (int16_t)lerp_float(old_display_moneys[i], new_display_moneys[i],
-                            money_animation_start[i], 2.5, 1.0);
-  }
-  BeginDrawing();
-  BeginTextureMode(canvas);
-  ClearBackground(GREEN);
-  // Draw cards
-  for (int i = 0; i < CARD_COUNT; i++) {
-    draw_card(face_values[i], card_positions[i], card_rotations[i],
-              card_flips[i]);
-  }
-  // Draw player moneys
-  char buffer[64] = {};
-  snprintf(buffer, 64, "P1:  $%d\nP2:  $%d\nP3:  $%d\nYou: $%d\n",
-           display_moneys[0], display_moneys[1], display_moneys[2],
-           display_moneys[3]);
-  draw_text(buffer, (Vector2){10, (float)WORLD_HEIGHT / 2 + CARD_HEIGHT}, 20,
-            BLACK);
-  // Draw pot money
-  snprintf(buffer, 64, "Pot: $%d", display_moneys[4]);
-  draw_text_centered(
-      buffer, (Vector2){WORLD_WIDTH / 2.0, WORLD_HEIGHT / 2.0 - CARD_HEIGHT},
-      20, BLACK);
-  // Draw result
-  if (display_hand != 0) {
-    draw_text_centered(
-        hand_value_string(display_hand),
-        (Vector2){WORLD_WIDTH / 2.0, WORLD_HEIGHT / 2.0 + CARD_HEIGHT}, 20,
-        BLACK);
-  }
-  // Gui
-  EndTextureMode();
-  Rectangle src = {0, 0, WORLD_WIDTH, -WORLD_HEIGHT};
-  // Correct for window's aspect ratio
-  window = (Rectangle){0, 0, GetScreenWidth(), GetScreenHeight()};
-  float window_ratio = window.width / window.height;
-  if (window_ratio >= 16.0 / 9.0) {
-    // Too wide
-    float new_width = (window.height / 9.0) * 16.0;
-    window.x += (window.width - new_width) / 2.0;
-    window.width = new_width;
-  } else {
-    // Too tall
-    float new_height = (window.width / 16.0) * 9.0;
-    window.y += (window.height - new_height) / 2.0;
-    window.height = new_height;
-  }
-  ClearBackground(BLACK);
-  DrawTexturePro(canvas.texture, src, window, (Vector2){0, 0}, 0, WHITE);
-  draw_ui();
-  if (is_caught != 0) {
-    draw_caught();
-  }
-  EndDrawing();
-}
+#include "drawing.h"
+#include "cards.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "stats.h"
+#include "trace.h"
+#include <math.h>
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EVENT_QUEUE_SIZE 256
+#define RAYGUI_IMPLEMENTATION
+#include "raygui.h"
+#ifdef EMBED_CARD_ATLAS
+// Generated from res/cards_sheet.png by embed_atlas, see the Makefile
+#include "cards_atlas.h"
+#endif
+
+HandValue display_hand = 0;
+
+static RenderTexture2D canvas;
+
+static int init = 0;
+static Texture2D card_atlas;
+int is_caught = 0;
+
+void draw_card(Card card, Vector2 position, float rotation, float flip) {
+  if (card == 0 || init == 0)
+    return;
+  if (flip < 0.0) {
+    card = BACKFACE;
+    flip = -flip;
+  }
+
+  int face = get_face(card) - 1;
+  int suite = (get_suite(card) >> 8) - 1;
+
+  Rectangle src_rect = (Rectangle){.x = face * CARD_WIDTH,
+                                   .y = suite * CARD_HEIGHT,
+                                   .width = CARD_WIDTH,
+                                   .height = CARD_HEIGHT};
+  Rectangle dst_rect = (Rectangle){.x = position.x,
+                                   .y = position.y,
+                                   .width = CARD_WIDTH * flip,
+                                   .height = CARD_HEIGHT};
+  DrawTexturePro(
+      card_atlas, src_rect, dst_rect,
+      (Vector2){.x = CARD_WIDTH / 2.0 * flip, .y = CARD_HEIGHT / 2.0}, rotation,
+      RAYWHITE);
+}
+
+const Vector2 ZERO = {0, 0};
+const float FLIP_SPEED = 8.0;
+const float MOVE_SPEED = 4.0;
+const float ROTATE_SPEED = 6.0;
+const float MONEY_SPEED = 2.5;
+const float FONT_SPACING = 4.0;
+
+// App state
+static float frame_time = 1.0 / 60.0;
+static float current_time = 0.0;
+// Game state
+static Vector2 card_positions[CARD_COUNT];
+static float card_rotations[CARD_COUNT];
+static float card_flips[CARD_COUNT];
+// Animation state
+static float animation_start[CARD_COUNT];
+static Vector2 card_old_positions[CARD_COUNT];
+static Vector2 card_new_positions[CARD_COUNT];
+static float card_old_rotations[CARD_COUNT];
+static float card_new_rotations[CARD_COUNT];
+static float card_old_flips[CARD_COUNT];
+static float card_new_flips[CARD_COUNT];
+
+static int32_t display_moneys[5] = {};
+static int32_t old_display_moneys[5] = {};
+static int32_t new_display_moneys[5] = {};
+static float money_animation_start[5] = {};
+
+// Canvas cache state. The canvas is only re-rendered when something drawn on
+// it changed since the last render, otherwise last frame's canvas is reused
+static bool canvas_dirty = true;
+static bool canvas_changed = true;
+static HandValue drawn_hand = 0;
+static Card drawn_face_values[CARD_COUNT];
+static uint32_t drawn_stats_version = 0;
+
+// Animation event queue
+typedef struct {
+  size_t card;
+  Vector2 position;
+  float rotation;
+  float flip;
+} MoveEvent;
+typedef struct {
+  uint8_t tag;
+  union {
+    MoveEvent move;
+    float wait;
+    struct {
+      size_t wallet;
+      int16_t amount;
+    } money;
+  } variant;
+} Event;
+static Event event_queue[EVENT_QUEUE_SIZE];
+static size_t event_queue_start = 0;
+static size_t event_queue_end = 0;
+static float last_event_start = 0;
+// When disabled, animation events take effect immediately instead of being
+// queued, so the game can run without a window
+static bool animations_enabled = true;
+// Trace clock time of last_event_start
+static uint64_t last_event_trace_start = 0;
+
+const Vector2 DECK_POSITION = {(float)WORLD_WIDTH / 2 - 200,
+                               (float)WORLD_HEIGHT / 2};
+
+const Vector2 HAND_POSITIONS[4][2] = {
+    {{0, (float)WORLD_HEIGHT / 2 + CARD_WIDTH / 2},
+     {0, (float)WORLD_HEIGHT / 2 - CARD_WIDTH / 2}},
+
+    {{(float)WORLD_WIDTH / 2 + CARD_WIDTH / 2, 0},
+     {(float)WORLD_WIDTH / 2 - CARD_WIDTH / 2, 0}},
+
+    {{WORLD_WIDTH, (float)WORLD_HEIGHT / 2 + CARD_WIDTH / 2},
+     {WORLD_WIDTH, (float)WORLD_HEIGHT / 2 - CARD_WIDTH / 2}},
+
+    {{(float)WORLD_WIDTH / 2 + CARD_WIDTH / 2, WORLD_HEIGHT},
+     {(float)WORLD_WIDTH / 2 - CARD_WIDTH / 2, WORLD_HEIGHT}},
+};
+
+void init_drawing() {
+  SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+  InitWindow(WORLD_WIDTH, WORLD_HEIGHT, "Hold'em");
+  SetWindowTitle("Rowdy Hold'em");
+  canvas = LoadRenderTexture(WORLD_WIDTH, WORLD_HEIGHT);
+#ifdef EMBED_CARD_ATLAS
+  Image atlas_image = {.data = CARDS_ATLAS_DATA,
+                       .width = CARDS_ATLAS_WIDTH,
+                       .height = CARDS_ATLAS_HEIGHT,
+                       .mipmaps = 1,
+                       .format = CARDS_ATLAS_FORMAT};
+  card_atlas = LoadTextureFromImage(atlas_image);
+#else
+  card_atlas = LoadTexture("res/cards_sheet.png");
+#endif
+  for (int i = 0; i < CARD_COUNT; i++) {
+    card_positions[i] = card_old_positions[i] = card_new_positions[i] =
+        DECK_POSITION;
+    card_flips[i] = card_old_flips[i] = card_new_flips[i] = -1.0;
+    card_rotations[i] = card_old_rotations[i] = card_new_rotations[i] = 0;
+    animation_start[i] = GetTime();
+  }
+  last_event_start = GetTime();
+  last_event_trace_start = trace_now();
+  frame_time = GetFrameTime();
+  current_time = GetTime();
+  init = 1;
+}
+
+float lerp_float(float start, float end, float delta, float speed,
+                 float degree) {
+  delta = pow((current_time - delta) * speed, degree);
+  if (delta > 1.0)
+    delta = 1.0;
+  if (delta < 0.0)
+    delta = 0.0;
+  return (start + (end - start) * (delta * delta));
+}
+Vector2 lerp_v2(Vector2 start, Vector2 end, float delta, float speed,
+                float degree) {
+  return (Vector2){lerp_float(start.x, end.x, delta, speed, degree),
+                   lerp_float(start.y, end.y, delta, speed, degree)};
+}
+
+void exec_now(Event event) {
+  switch (event.tag) {
+  case 0: {
+    MoveEvent ev = event.variant.move;
+    card_old_positions[ev.card] = card_new_positions[ev.card] =
+        card_positions[ev.card] = ev.position;
+
+    card_old_rotations[ev.card] = card_new_rotations[ev.card] =
+        card_rotations[ev.card] = ev.rotation;
+
+    card_old_flips[ev.card] = card_new_flips[ev.card] = card_flips[ev.card] =
+        ev.flip;
+    canvas_dirty = true;
+    break;
+  }
+  case 1: {
+    break;
+  }
+  case 2: {
+    size_t wallet = event.variant.money.wallet;
+    old_display_moneys[wallet] = new_display_moneys[wallet] =
+        display_moneys[wallet] = event.variant.money.amount;
+    canvas_dirty = true;
+    break;
+  }
+  }
+}
+
+void update_anim_queue_metrics() {
+  size_t depth = (event_queue_end + EVENT_QUEUE_SIZE - event_queue_start) %
+                 EVENT_QUEUE_SIZE;
+  metric_set(MetricAnimQueueDepth, depth);
+  metric_max(MetricAnimQueueHighWater, depth);
+}
+
+void queue_anim(Event e) {
+  if (!animations_enabled) {
+    // Jump straight to the end state of the animation
+    exec_now(e);
+    return;
+  }
+  event_queue_end += 1;
+  event_queue_end %= EVENT_QUEUE_SIZE;
+  if (event_queue_end == event_queue_start) {
+    exec_now(event_queue[event_queue_start]);
+    event_queue_start += 1;
+    event_queue_start %= EVENT_QUEUE_SIZE;
+    metric_add(MetricAnimEvents, 1);
+  }
+  event_queue[event_queue_end] = e;
+  update_anim_queue_metrics();
+}
+
+void set_animations_enabled(bool enabled) { animations_enabled = enabled; }
+
+int is_animations_finished() { return event_queue_start == event_queue_end; }
+
+int is_canvas_animating() { return canvas_changed; }
+
+float get_anim_wait_remaining() {
+  if (event_queue_start == event_queue_end)
+    return -1.0;
+  Event next_ev = event_queue[(event_queue_start + 1) % EVENT_QUEUE_SIZE];
+  if (next_ev.tag != 1)
+    return 0.0;
+  float remaining = last_event_start + next_ev.variant.wait - GetTime();
+  return remaining > 0.0 ? remaining : 0.0;
+}
+
+void queue_anim_move(size_t card, Vector2 position, float rotation,
+                     float flip) {
+  queue_anim((Event){.tag = 0,
+                     .variant.move = (MoveEvent){.card = card,
+                                                 .position = position,
+                                                 .rotation = rotation,
+                                                 .flip = flip}});
+}
+void flip_card(size_t card) {
+  queue_anim_move(card, card_new_positions[card], card_new_rotations[card],
+                  -card_flips[card]);
+}
+
+void queue_anim_money(size_t wallet, uint16_t new_amount) {
+  queue_anim((Event){.tag = 2, .variant.money = {wallet, new_amount}});
+};
+
+void queue_anim_wait(float time) {
+  queue_anim((Event){.tag = 1, .variant.wait = time});
+}
+
+void draw_text(char *text, Vector2 position, int font_size, Color color) {
+  DrawTextEx(GetFontDefault(), text, position, font_size, FONT_SPACING, color);
+}
+
+void draw_text_centered(char *text, Vector2 position, int font_size,
+                        Color color) {
+  Vector2 size =
+      MeasureTextEx(GetFontDefault(), text, font_size, FONT_SPACING);
+  position.x -= size.x / 2;
+  position.y -= size.y / 2;
+  // Draw text
+  DrawTextEx(GetFontDefault(), text, position, font_size, FONT_SPACING, color);
+}
+
+// Cached text: the formatted string and its glyph quads for the default font.
+// These are only rebuilt when the values shown by the text change, so drawing
+// the text is a run of textured quads from the font texture
+#define CACHED_TEXT_LENGTH 64
+typedef struct {
+  int32_t values[4];
+  bool valid;
+  char text[CACHED_TEXT_LENGTH];
+  Vector2 size;
+  size_t glyph_count;
+  Rectangle glyph_src[CACHED_TEXT_LENGTH];
+  Rectangle glyph_dst[CACHED_TEXT_LENGTH];
+} CachedText;
+static CachedText wallets_text;
+static CachedText pot_text;
+static CachedText hand_text;
+static CachedText stats_text;
+
+// Returns true and stores the new values if `cached` shows different values
+bool cached_text_changed(CachedText *cached, const int32_t *values,
+                         size_t count) {
+  if (cached->valid &&
+      memcmp(cached->values, values, count * sizeof(int32_t)) == 0)
+    return false;
+  memcpy(cached->values, values, count * sizeof(int32_t));
+  cached->valid = true;
+  return true;
+}
+
+// Lay out the glyphs of `cached->text` the same way DrawTextEx does
+void bake_cached_text(CachedText *cached, int font_size) {
+  Font font = GetFontDefault();
+  float scale = (float)font_size / font.baseSize;
+  float padding = font.glyphPadding;
+  float line_advance =
+      MeasureTextEx(font, "A\nA", font_size, FONT_SPACING).y -
+      MeasureTextEx(font, "A", font_size, FONT_SPACING).y;
+  cached->size = MeasureTextEx(font, cached->text, font_size, FONT_SPACING);
+  cached->glyph_count = 0;
+  Vector2 offset = ZERO;
+  for (size_t i = 0; cached->text[i] != 0; i++) {
+    char c = cached->text[i];
+    if (c == '\n') {
+      offset.x = 0;
+      offset.y += line_advance;
+      continue;
+    }
+    int index = GetGlyphIndex(font, c);
+    Rectangle rec = font.recs[index];
+    if (c != ' ' && c != '\t') {
+      cached->glyph_src[cached->glyph_count] =
+          (Rectangle){rec.x - padding, rec.y - padding,
+                      rec.width + 2 * padding, rec.height + 2 * padding};
+      cached->glyph_dst[cached->glyph_count] = (Rectangle){
+          offset.x + (font.glyphs[index].offsetX - padding) * scale,
+          offset.y + (font.glyphs[index].offsetY - padding) * scale,
+          (rec.width + 2 * padding) * scale,
+          (rec.height + 2 * padding) * scale};
+      cached->glyph_count += 1;
+    }
+    float advance = font.glyphs[index].advanceX;
+    if (advance == 0)
+      advance = rec.width;
+    offset.x += advance * scale + FONT_SPACING;
+  }
+}
+
+void draw_cached_text(CachedText *cached, Vector2 position, Color color) {
+  Texture2D font_texture = GetFontDefault().texture;
+  for (size_t i = 0; i < cached->glyph_count; i++) {
+    Rectangle dst = cached->glyph_dst[i];
+    dst.x += position.x;
+    dst.y += position.y;
+    DrawTexturePro(font_texture, cached->glyph_src[i], dst, ZERO, 0, color);
+  }
+}
+
+void draw_cached_text_centered(CachedText *cached, Vector2 position,
+                               Color color) {
+  position.x -= cached->size.x / 2;
+  position.y -= cached->size.y / 2;
+  draw_cached_text(cached, position, color);
+}
+
+void update_text_cache() {
+  if (cached_text_changed(&wallets_text, display_moneys, 4)) {
+    snprintf(wallets_text.text, CACHED_TEXT_LENGTH,
+             "P1:  $%d\nP2:  $%d\nP3:  $%d\nYou: $%d\n", display_moneys[0],
+             display_moneys[1], display_moneys[2], display_moneys[3]);
+    bake_cached_text(&wallets_text, 20);
+  }
+  if (cached_text_changed(&pot_text, &display_moneys[4], 1)) {
+    snprintf(pot_text.text, CACHED_TEXT_LENGTH, "Pot: $%d", display_moneys[4]);
+    bake_cached_text(&pot_text, 20);
+  }
+  int32_t hand = display_hand;
+  if (cached_text_changed(&hand_text, &hand, 1)) {
+    snprintf(hand_text.text, CACHED_TEXT_LENGTH, "%s",
+             hand == 0 ? "" : hand_value_string(hand));
+    bake_cached_text(&hand_text, 20);
+  }
+  // Bot HUD: VPIP/PFR percentages and aggression factor over recent hands
+  int32_t stats_version = get_stats_version();
+  if (cached_text_changed(&stats_text, &stats_version, 1)) {
+    size_t length = 0;
+    for (size_t i = 0; i < 3 && length < CACHED_TEXT_LENGTH; i++) {
+      SeatStats stats = get_recent_seat_stats(i);
+      length += snprintf(stats_text.text + length, CACHED_TEXT_LENGTH - length,
+                         "P%zu: %d/%d AF %.1f\n", i + 1,
+                         (int)(stats.vpip * 100), (int)(stats.pfr * 100),
+                         stats.aggression);
+    }
+    bake_cached_text(&stats_text, 10);
+  }
+}
+
+ButtonState button_choice = NoButton;
+
+float bet_spinner_value = 0;
+
+Rectangle window = {};
+
+// Retained layout of the GUI controls. Only recomputed when the screen size
+// changes
+typedef struct {
+  int screen_width;
+  int screen_height;
+  Rectangle panel;
+  Rectangle bet_button;
+  Rectangle call_button;
+  Rectangle fold_button;
+  Rectangle slider;
+  Rectangle caught_panel;
+} UiLayout;
+static UiLayout layout = {};
+
+// raygui style currently written into raygui's style table
+typedef enum {
+  NoStyle,
+  PanelStyle,
+  CaughtStyle,
+} UiStyle;
+static UiStyle applied_style = NoStyle;
+
+// Bet slider label, reformatted only when the slider value changes
+static int bet_label_value = -1;
+static char bet_label[64] = {};
+
+void update_ui_layout() {
+  int screen_width = GetScreenWidth();
+  int screen_height = GetScreenHeight();
+  if (screen_width == layout.screen_width &&
+      screen_height == layout.screen_height)
+    return;
+  layout.screen_width = screen_width;
+  layout.screen_height = screen_height;
+  // Styles are scaled to the window, so they need to be reapplied
+  applied_style = NoStyle;
+  // Correct for window's aspect ratio
+  window = (Rectangle){0, 0, screen_width, screen_height};
+  float window_ratio = window.width / window.height;
+  if (window_ratio >= 16.0 / 9.0) {
+    // Too wide
+    float new_width = (window.height / 9.0) * 16.0;
+    window.x += (window.width - new_width) / 2.0;
+    window.width = new_width;
+  } else {
+    // Too tall
+    float new_height = (window.width / 16.0) * 9.0;
+    window.y += (window.height - new_height) / 2.0;
+    window.height = new_height;
+  }
+  // Panel
+  Vector2 center = {window.x + (float)window.width * 0.8,
+                    window.y + (float)window.height * 0.85};
+  Vector2 size = {0.3125 * window.width, 0.208 * window.height};
+  Rectangle bounds = {.x = center.x - size.x / 2,
+                      .y = center.y - size.y / 2,
+                      .width = size.x,
+                      .height = size.y};
+  layout.panel = bounds;
+  // Buttons
+  layout.bet_button = (Rectangle){.x = bounds.x,
+                                  .y = bounds.y,
+                                  .width = bounds.width / 3,
+                                  .height = bounds.height / 2};
+  layout.call_button = (Rectangle){.x = bounds.x + bounds.width / 3,
+                                   .y = bounds.y,
+                                   .width = bounds.width / 3,
+                                   .height = bounds.height / 2};
+  layout.fold_button = (Rectangle){.x = bounds.x + bounds.width / 3 * 2,
+                                   .y = bounds.y,
+                                   .width = bounds.width / 3,
+                                   .height = bounds.height / 2};
+  // Slider
+  layout.slider = (Rectangle){bounds.x, bounds.y + bounds.height / 2.0,
+                              .width = bounds.width,
+                              .height = bounds.height / 2};
+  // Caught message
+  center = (Vector2){window.x + (float)window.width * 0.5,
+                     window.y + (float)window.height * 0.5};
+  size = (Vector2){0.8 * (float)window.width, 0.8 * (float)window.height};
+  layout.caught_panel = (Rectangle){.x = center.x - size.x / 2,
+                                    .y = center.y - size.y / 2,
+                                    .width = size.x,
+                                    .height = size.y};
+}
+
+void apply_ui_style(UiStyle style) {
+  if (style == applied_style)
+    return;
+  applied_style = style;
+  float text_size = style == CaughtStyle ? 0.07 : 0.04;
+  float line_spacing = style == CaughtStyle ? 35.0 : 20.0;
+  GuiSetStyle(DEFAULT, TEXT_SIZE, (int)(text_size * window.height));
+  GuiSetStyle(DEFAULT, TEXT_SPACING, (4.0 / 640.0) * window.height);
+  GuiSetStyle(DEFAULT, TEXT_LINE_SPACING,
+              (line_spacing / 640.0) * window.height);
+  GuiSetStyle(DEFAULT, TEXTURE_FILTER_ANISOTROPIC_4X, 1);
+}
+
+void draw_caught() {
+  apply_ui_style(CaughtStyle);
+  GuiPanel(layout.caught_panel, NULL);
+  GuiDrawText("You have been caught cheating!\nGet out of my casino!!!",
+              layout.caught_panel, 1, BLACK);
+}
+
+void draw_ui() {
+  apply_ui_style(PanelStyle);
+  // Panel
+  GuiPanel(layout.panel, NULL);
+  // Buttons
+  if (GuiButton(layout.bet_button, "BET"))
+    button_choice = BetButton;
+  if (GuiButton(layout.call_button, "CALL"))
+    button_choice = CallButton;
+  if (GuiButton(layout.fold_button, "FOLD"))
+    button_choice = FoldButton;
+  // Slider
+  GuiSlider(layout.slider, NULL, NULL, &bet_spinner_value, 0.0, 2000.0);
+  bet_spinner_value = roundf(bet_spinner_value / 10.0) * 10.0;
+  if ((int)bet_spinner_value != bet_label_value) {
+    bet_label_value = (int)bet_spinner_value;
+    snprintf(bet_label, 64, "$%d", bet_label_value);
+  }
+  GuiDrawText(bet_label, layout.slider, 1, BLACK);
+}
+
+// Render the table into the canvas render texture
+void render_canvas() {
+  BeginTextureMode(canvas);
+  ClearBackground(GREEN);
+  // Draw cards
+  for (int i = 0; i < CARD_COUNT; i++) {
+    draw_card(face_values[i], card_positions[i], card_rotations[i],
+              card_flips[i]);
+  }
+  // Text is drawn after all cards, so it is one run of font texture quads
+  update_text_cache();
+  // Draw player moneys
+  draw_cached_text(&wallets_text,
+                   (Vector2){10, (float)WORLD_HEIGHT / 2 + CARD_HEIGHT}, BLACK);
+  draw_cached_text(&stats_text,
+                   (Vector2){10, (float)WORLD_HEIGHT / 2 + CARD_HEIGHT +
+                                     wallets_text.size.y + 10},
+                   BLACK);
+  // Draw pot money
+  draw_cached_text_centered(
+      &pot_text, (Vector2){WORLD_WIDTH / 2.0, WORLD_HEIGHT / 2.0 - CARD_HEIGHT},
+      BLACK);
+  // Draw result
+  draw_cached_text_centered(
+      &hand_text,
+      (Vector2){WORLD_WIDTH / 2.0, WORLD_HEIGHT / 2.0 + CARD_HEIGHT}, BLACK);
+  EndTextureMode();
+}
+
+size_t get_frames_rendered() { return metric_get(MetricFramesRendered); }
+
+size_t get_frames_skipped() { return metric_get(MetricFramesSkipped); }
+
+// Record an animation event that runs for `duration` seconds from now
+void trace_anim_started(const char *name, float duration, const char *arg_name,
+                        int64_t arg) {
+  if (!trace_enabled)
+    return;
+  uint64_t now = trace_now();
+  trace_span(name, "animation", now, now + (uint64_t)(duration * 1e6),
+             arg_name, arg, NULL, 0);
+  last_event_trace_start = now;
+}
+
+// Record a wait event from when it started waiting until now
+void trace_anim_wait_finished(float wait_time) {
+  if (!trace_enabled)
+    return;
+  uint64_t now = trace_now();
+  trace_span("wait", "animation", last_event_trace_start, now, "wait_ms",
+             (int64_t)(wait_time * 1000), NULL, 0);
+  last_event_trace_start = now;
+}
+
+void draw() {
+  profile_begin(StageAnimation);
+  current_time = GetTime();
+  // Process event queue
+  if (event_queue_start != event_queue_end) {
+    size_t current_index = (event_queue_start + 1) % EVENT_QUEUE_SIZE;
+    Event current_ev = event_queue[current_index];
+    switch (current_ev.tag) {
+    case 0: {
+      MoveEvent ev = current_ev.variant.move;
+      card_old_positions[ev.card] = card_positions[ev.card];
+      card_new_positions[ev.card] = ev.position;
+
+      card_old_rotations[ev.card] = card_rotations[ev.card];
+      card_new_rotations[ev.card] = ev.rotation;
+
+      card_old_flips[ev.card] = card_flips[ev.card];
+      card_new_flips[ev.card] = ev.flip;
+
+      animation_start[ev.card] = current_time;
+      event_queue_start = current_index;
+      last_event_start = current_time;
+      trace_anim_started("move", 1.0 / MOVE_SPEED, "card", ev.card);
+      break;
+    }
+    case 1: {
+      float wait_time = current_ev.variant.wait;
+      if (last_event_start + wait_time <= current_time) {
+        event_queue_start = current_index;
+        last_event_start = current_time;
+        trace_anim_wait_finished(wait_time);
+      }
+      break;
+    }
+    case 2: {
+      uint16_t wallet = current_ev.variant.money.wallet;
+      uint16_t amount = current_ev.variant.money.amount;
+      old_display_moneys[wallet] = display_moneys[wallet];
+      new_display_moneys[wallet] = amount;
+      money_animation_start[wallet] = current_time;
+      event_queue_start = current_index;
+      last_event_start = current_time;
+      trace_anim_started("money", 1.0 / MONEY_SPEED, "wallet", wallet);
+      break;
+    }
+    }
+    if (event_queue_start == current_index) {
+      metric_add(MetricAnimEvents, 1);
+      update_anim_queue_metrics();
+    }
+  }
+  // Card animations
+  for (int i = 0; i < CARD_COUNT; i++) {
+    float flip = lerp_float(card_old_flips[i], card_new_flips[i],
+                            animation_start[i], FLIP_SPEED, 1);
+    Vector2 position = lerp_v2(card_old_positions[i], card_new_positions[i],
+                               animation_start[i], MOVE_SPEED, 0.5);
+    float rotation = lerp_float(card_old_rotations[i], card_new_rotations[i],
+                                animation_start[i], ROTATE_SPEED, 0.25);
+    if (flip != card_flips[i] || position.x != card_positions[i].x ||
+        position.y != card_positions[i].y || rotation != card_rotations[i])
+      canvas_dirty = true;
+    card_flips[i] = flip;
+    card_positions[i] = position;
+    card_rotations[i] = rotation;
+  }
+  // Money animations
+  for (int i = 0; i < 5; i++) {
+    int32_t money =
+        (int16_t)lerp_float(old_display_moneys[i], new_display_moneys[i],
+                            money_animation_start[i], MONEY_SPEED, 1.0);
+    if (money != display_moneys[i])
+      canvas_dirty = true;
+    display_moneys[i] = money;
+  }
+  // The stats HUD changes after a hand without anything else on the table
+  // moving
+  uint32_t stats_version = get_stats_version();
+  if (display_hand != drawn_hand || stats_version != drawn_stats_version ||
+      memcmp(face_values, drawn_face_values, sizeof(face_values)) != 0)
+    canvas_dirty = true;
+  profile_end(StageAnimation);
+  BeginDrawing();
+  canvas_changed = canvas_dirty;
+  if (canvas_dirty) {
+    profile_begin(StageCanvas);
+    render_canvas();
+    profile_end(StageCanvas);
+    drawn_hand = display_hand;
+    drawn_stats_version = stats_version;
+    memcpy(drawn_face_values, face_values, sizeof(face_values));
+    canvas_dirty = false;
+    metric_add(MetricFramesRendered, 1);
+  } else {
+    metric_add(MetricFramesSkipped, 1);
+  }
+  Rectangle src = {0, 0, WORLD_WIDTH, -WORLD_HEIGHT};
+  update_ui_layout();
+  profile_begin(StageBlit);
+  ClearBackground(BLACK);
+  DrawTexturePro(canvas.texture, src, window, (Vector2){0, 0}, 0, WHITE);
+  profile_end(StageBlit);
+  profile_begin(StageUi);
+  draw_ui();
+  if (is_caught != 0) {
+    draw_caught();
+  }
+  profile_end(StageUi);
+  draw_profiler();
+  // Includes the buffer swap and waiting for the next frame
+  profile_begin(StagePresent);
+  EndDrawing();
+  profile_end(StagePresent);
+}
@@ -0,0 +1,25 @@
+// Build tool: decodes an image and writes it as raw RGBA pixel data into a C
+// header, so the game can upload the card atlas without any file I/O or PNG
+// decoding at startup.
+// Usage: embed_atlas <image.png> <output.h>
+#include <raylib.h>
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    printf("Usage: %s <image.png> <output.h>\n", argv[0]);
+    return 1;
+  }
+  SetTraceLogLevel(LOG_WARNING);
+  Image image = LoadImage(argv[1]);
+  if (image.data == NULL) {
+    printf("Could not load %s\n", argv[1]);
+    return 1;
+  }
+  // Match the format the GPU texture is created with
+  ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+  // The array and macro names are derived from the output file name
+  bool success = ExportImageAsCode(image, argv[2]);
+  UnloadImage(image);
+  return success ? 0 : 1;
+}
@@ -1,362 +1,862 @@
-#include "cards.h"
-#include "drawing.h"
-#include <raylib.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include <stdlib.h>
-// Maximum number of events in the gameloop event queue
-#define EVENT_QUEUE_SIZE 128
-static size_t event_queue_start = 0;
-static size_t event_queue_end = 0;
-// Enum for seats at the table / the players in them
-typedef enum {
-  Bot1,
-  Bot2,
-  Bot3,
-  Player,
-} Seat;
-
-// Game state data
-static size_t hands[4][2] = {};
-static int32_t money[5] = {1000, 1000, 1000, 1000, 0};
-static int32_t current_bets[4] = {};
-static bool folded[4] = {};
-static size_t board[5] = {};
-static size_t current_card = 0;
-
-void fold(Seat who) { folded[who] = true; }
-
-void call(Seat who) {
-  int32_t max_bet = 0;
-  for (int i = 0; i < 4; i++) {
-    if (current_bets[i] > max_bet)
-      max_bet = current_bets[i];
-  }
-  int32_t amount_to_call = max_bet - current_bets[who];
-  if (amount_to_call > money[who] || folded[who]) {
-    fold(who);
-    return;
-  }
-  money[who] -= amount_to_call;
-  queue_anim_money(who, money[who]);
-  current_bets[who] += amount_to_call;
-  money[4] += amount_to_call;
-  queue_anim_money(4, money[4]);
-}
-
-// Player `who` bets `amount` to the pot. This checks to prevent betting more
-// than you have, and prevents split pots by capping the bet to the poorest
-// players money
-void bet(Seat who, int32_t amount) {
-  // Prevent betting more than poorest player still in the game
-  call(who);
-  if (folded[who])
-    return;
-  int32_t total_amount = money[4];
-  for (size_t i = 0; i < 4; i++) {
-    total_amount += money[i];
-    int32_t amount_to_call = money[4] + amount - current_bets[i];
-    if (amount_to_call > money[i] && !folded[i]) {
-      amount -= amount_to_call - money[i];
-      amount = money[i];
-    }
-  }
-  if (amount <= 0)
-    return;
-  // Check for invalid money amount
-  if (total_amount != 4000)
-    event_queue_start = event_queue_end;
-  money[who] -= amount;
-  current_bets[who] += amount;
-  queue_anim_money(who, money[who]);
-  money[4] += amount;
-  queue_anim_money(4, money[4]);
-}
-
-void all_in(Seat who) { bet(who, money[who]); }
-
-// Move all money in the pot to specified player
-void payout(Seat who) {
-  money[who] += money[4];
-  queue_anim_money(who, money[who]);
-  money[4] = 0;
-  queue_anim_money(4, 0);
-}
-
-// Deal card onto the board
-void deal_faceup(size_t card, size_t slot) {
-  board[slot] = card;
-  queue_anim_move(
-      card,
-      (Vector2){(float)WORLD_WIDTH / 2 + CARD_WIDTH * slot - (CARD_WIDTH * 2),
-                (float)WORLD_HEIGHT / 2},
-      180, 1);
-}
-
-void deal_player(size_t card, Seat seat, size_t slot) {
-  hands[seat][slot] = card;
-  Vector2 pos = HAND_POSITIONS[seat][slot];
-  switch (seat) {
-  case Bot1: {
-    queue_anim_move(card, pos, -90, -1);
-    break;
-  }
-  case Bot2: {
-    queue_anim_move(card, pos, 180, -1);
-    break;
-  }
-  case Bot3: {
-    queue_anim_move(card, pos, 90, -1);
-    break;
-  }
-  case Player: {
-    queue_anim_move(card, pos, 180, 1);
-    break;
-  }
-  }
-}
-
-typedef enum {
-  // Cards move back to origin position, face values are shuffled
-  Shuffle = 0,
-  // Players are dealt hands, initial betting
-  PreFlop = 1,
-  // First three cards are dealt to table, betting
-  Flop = 2,
-  // Fourth card is dealt to table, betting
-  Turn = 3,
-  // Fifth card is dealt to table, betting
-  River = 4,
-  // Hands are revealed, payout to winner
-  Showdown = 5
-} GamePhase;
-
-static GamePhase current_phase = Shuffle;
-
-// Event object
-typedef struct {
-  enum { AdvancePhase, AdvanceTurn } tag;
-  union {
-    GamePhase next_phase;
-    Seat next_turn;
-  } variant;
-} Event;
-// Event loop state
-static Event event_queue[EVENT_QUEUE_SIZE];
-static float last_event_start = 0;
-
-void queue_event(Event event) {
-  event_queue_end += 1;
-  event_queue_end %= EVENT_QUEUE_SIZE;
-  event_queue[event_queue_end] = event;
-}
-
-void queue_game_phase(GamePhase phase) {
-  queue_event((Event){.tag = AdvancePhase, .variant.next_phase = phase});
-}
-
-void queue_next_game_phase() {
-  switch (current_phase) {
-  case Shuffle:
-    queue_game_phase(PreFlop);
-    break;
-  case PreFlop:
-    queue_game_phase(Flop);
-    break;
-  case Flop:
-    queue_game_phase(Turn);
-    break;
-  case Turn:
-    queue_game_phase(River);
-    break;
-  case River:
-    queue_game_phase(Showdown);
-    break;
-  case Showdown:
-    queue_game_phase(Shuffle);
-    break;
-  }
-}
-
-void queue_turn_order() {
-  // Do not queue turns if someone is all in
-  for (int i = 0; i < 4; i++) {
-    if (!folded[i]) {
-      queue_event((Event){.tag = AdvanceTurn, .variant.next_turn = i});
-    }
-  }
-}
-
-// The core game loop: execute the next event and pop it if finished
-void tick_game() {
-
-  execute_anti_disassembly();
-
-  if (event_queue_start == event_queue_end) {
-    is_caught = 1;
-  } else {
-    float current_time = GetTime();
-    size_t current_index = (event_queue_start + 1) % EVENT_QUEUE_SIZE;
-    Event current_ev = event_queue[current_index];
-    switch (current_ev.tag) {
-    case AdvancePhase: {
-      // Wait for animations to catch up
-      if (!is_animations_finished()) {
-        return;
-      }
-      current_phase = current_ev.variant.next_phase;
-      for (int i = 0; i < 5; i++)
-        current_bets[i] = 0;
-      switch (current_phase) {
-      case Shuffle: {
-        for (int i = 0; i < CARD_COUNT; i++) {
-          queue_anim_move(i, DECK_POSITION, 0, -1);
-          queue_anim_wait(0.01);
-        }
-        for (int i = 0; i < CARD_COUNT; i += 16) {
-          queue_anim_move(i, DECK_POSITION, 180, -1.0);
-          queue_anim_wait(0.03);
-        }
-        display_hand = 0;
-        queue_game_phase(PreFlop);
-        break;
-      }
-      case PreFlop:
-        shuffle_face_values();
-        current_card = 0;
-        for (int i = 0; i < 2; i++) {
-          for (int j = 0; j < 4; j++) {
-            deal_player(current_card++, j, i);
-            queue_anim_wait(0.2);
-          }
-        }
-        queue_turn_order();
-        break;
-      case Flop:
-        for (int i = 0; i < 3; i++) {
-          deal_faceup(current_card++, i);
-          queue_anim_wait(0.2);
-        }
-        queue_turn_order();
-        break;
-      case Turn:
-        deal_faceup(current_card++, 3);
-        queue_turn_order();
-        break;
-      case River:
-        deal_faceup(current_card++, 4);
-        queue_turn_order();
-        break;
-      case Showdown: {
-        HandValue max_value = 0;
-        size_t winning_player = Player;
-        Card this_board[5] = {
-            face_values[board[0]], face_values[board[1]], face_values[board[2]],
-            face_values[board[3]], face_values[board[4]],
-        };
-        for (int i = 0; i < Player; i++) {
-          flip_card(hands[i][0]);
-          flip_card(hands[i][1]);
-          queue_anim_wait(0.2);
-          if (!folded[i]) {
-            Card this_hand[2] = {face_values[hands[i][0]],
-                                 face_values[hands[i][1]]};
-            HandValue this_value = evaluate_hand(this_hand, this_board);
-            if (this_value > max_value) {
-              max_value = this_value;
-              winning_player = i;
-            }
-          }
-        }
-        display_hand = max_value;
-        payout(winning_player);
-        queue_anim_wait(5);
-        queue_next_game_phase();
-        break;
-      }
-      }
-      break;
-    }
-    case AdvanceTurn: {
-      Seat current_seat = current_ev.variant.next_turn;
-      if (folded[current_seat]) {
-        printf("Break\n");
-        break;
-      }
-      Card hand_values[2] = {face_values[hands[current_seat][0]],
-                             face_values[hands[current_seat][1]]};
-      Card board_values[5] = {
-          face_values[board[0]], face_values[board[1]], face_values[board[2]],
-          face_values[board[3]], face_values[board[4]],
-      };
-
-      // Blank out cards that aren't dealt yet
-      if (current_phase < Flop)
-        board_values[0] = board_values[1] = board_values[2] = 0;
-      if (current_phase < Turn)
-        board_values[3] = 0;
-      if (current_phase < River)
-        board_values[4] = 0;
-
-      HandValue value = evaluate_hand(hand_values, board_values);
-
-      if (current_seat != Player) {
-        // AI strategy
-        float random = (float)rand() / (float)(RAND_MAX);
-        call(current_seat);
-      } else {
-        // Player + last turn
-        switch (button_choice) {
-        case NoButton:
-          return;
-        case BetButton:
-          bet(current_seat, bet_spinner_value);
-          break;
-        case CallButton:
-          call(current_seat);
-          break;
-        case FoldButton:
-          fold(current_seat);
-          break;
-        }
-        button_choice = NoButton;
-        // Determine if turn order should repeat
-        bool do_next_turn = false;
-        int32_t max_bet = 0;
-        for (int i = 0; i < 4; i++)
-          if (current_bets[i] > max_bet && !folded[i])
-            max_bet = current_bets[i];
-        for (int i = 0; i < 4; i++)
-          if (current_bets[i] < max_bet && !folded[i])
-            do_next_turn = true;
-        if (do_next_turn) {
-          queue_turn_order();
-        } else {
-          queue_next_game_phase();
-        }
-      }
-      queue_anim_wait(1);
-      break;
-    }
-    }
-    event_queue_start = current_index;
-    last_event_start = current_time;
-  }
-}
-
-void start_gameloop() {
-  // Initialize game state
-  init_face_values();
-  init_drawing();
-  for (int i = 0; i < 4; i++) {
-    queue_anim_money(i, money[i]);
-  }
-  queue_game_phase(Shuffle);
-  // Start game loop
-  SetTargetFPS(60);
-  while (!WindowShouldClose()) {
-    tick_game();
-    draw();
-  }
-  CloseWindow();
-}
+#include "bot.h"
+#include "cards.h"
+#include "cfr.h"
+#include "debuggerFunctions.h"
+#include "drawing.h"
+#include "gameloop.h"
+#include "history.h"
+#include "integrity.h"
+#include "journal.h"
+#include "mcts.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "rules.h"
+#include "stats.h"
+#include "trace.h"
+#include <math.h>
+#include <raylib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+// Maximum number of events in the gameloop event queue
+#define EVENT_QUEUE_SIZE 128
+static size_t event_queue_start = 0;
+static size_t event_queue_end = 0;
+// Enum for seats at the table / the players in them
+typedef enum {
+  Bot1,
+  Bot2,
+  Bot3,
+  Player,
+} Seat;
+
+typedef enum {
+  // Cards move back to origin position, face values are shuffled
+  Shuffle = 0,
+  // Players are dealt hands, initial betting
+  PreFlop = 1,
+  // First three cards are dealt to table, betting
+  Flop = 2,
+  // Fourth card is dealt to table, betting
+  Turn = 3,
+  // Fifth card is dealt to table, betting
+  River = 4,
+  // Hands are revealed, payout to winner
+  Showdown = 5
+} GamePhase;
+
+static GamePhase current_phase = Shuffle;
+
+// Game state data
+static size_t hands[4][2] = {};
+static TableState table = {.money = {1000, 1000, 1000, 1000, 0}};
+static size_t board[5] = {};
+static size_t current_card = 0;
+// Bot decision being made on a worker thread, if any
+static BotTicket pending_decision = NO_BOT_TICKET;
+// Hand being recorded for the hand history, or being replayed from it
+static HandRecord hand_record;
+// Replay of hands from a history file, in place of the deal, the bots and
+// the player
+static bool replaying = false;
+static bool replay_finished = false;
+static size_t replay_next = 0;
+static size_t replay_end = 0;
+// Next recorded action of the hand being replayed
+static size_t replay_action = 0;
+
+// Add an action to the hand history, `chips` as resolved by the rules
+void record_action(Seat who, int32_t chips, bool raised) {
+  if (is_history_enabled() && !replaying)
+    history_add_action(&hand_record, current_phase - PreFlop, who, chips,
+                       raised);
+}
+
+void fold(Seat who) {
+  if (!table.folded[who]) {
+    stats_fold(who);
+    record_action(who, FOLD_CHIPS, false);
+  }
+  table.folded[who] = true;
+}
+
+// Money and bets are written through the integrity monitor so it can keep
+// checksums of them
+void add_money(size_t wallet, int32_t amount) {
+  integrity_write(MoneyRegion, wallet, table.money[wallet] + amount);
+}
+
+void add_bet(Seat who, int32_t amount) {
+  integrity_write(BetsRegion, who, table.current_bets[who] + amount);
+}
+
+// Apply chips resolved by the betting rules to the table
+void commit_chips(Seat who, int32_t chips) {
+  if (chips == FOLD_CHIPS) {
+    fold(who);
+    return;
+  }
+  add_money(who, -chips);
+  queue_anim_money(who, table.money[who]);
+  add_bet(who, chips);
+  add_money(POT, chips);
+  queue_anim_money(POT, table.money[POT]);
+}
+
+void call(Seat who) {
+  int32_t chips = resolve_call(&table, who);
+  if (chips != FOLD_CHIPS) {
+    stats_call(who, chips, current_phase == PreFlop);
+    record_action(who, chips, false);
+  }
+  commit_chips(who, chips);
+}
+
+// Player `who` bets `amount` to the pot, see resolve_bet()
+void bet(Seat who, int32_t amount) {
+  int32_t chips = resolve_bet(&table, who, amount);
+  // A bet capped down to the call is only a call
+  bool raised = chips != FOLD_CHIPS && chips > resolve_call(&table, who);
+  if (raised)
+    stats_bet(who, current_phase == PreFlop);
+  else if (chips != FOLD_CHIPS)
+    stats_call(who, chips, current_phase == PreFlop);
+  if (chips != FOLD_CHIPS)
+    record_action(who, chips, raised);
+  commit_chips(who, chips);
+}
+
+void all_in(Seat who) { bet(who, table.money[who]); }
+
+void start_replay(size_t first, size_t count) {
+  size_t hands = get_history_hand_count();
+  replaying = true;
+  replay_finished = false;
+  replay_next = first < hands ? first : hands;
+  replay_end = count < hands - replay_next ? replay_next + count : hands;
+}
+
+bool is_replay_finished() { return replay_finished; }
+
+// Stop replaying. The table is left as it is and tick_game() stops
+void finish_replay() {
+  replaying = false;
+  replay_finished = true;
+}
+
+void report_replay_mismatch() {
+  printf("Replay of hand %zu does not match the history\n", replay_next - 1);
+  metric_add(MetricReplayMismatches, 1);
+}
+
+// Read the next hand to replay and set the table to its starting stacks.
+// Returns false once the replay is over
+bool load_replay_hand() {
+  if (replay_next >= replay_end ||
+      !read_history_hand(replay_next, &hand_record))
+    return false;
+  replay_next++;
+  replay_action = 0;
+  for (int i = 0; i < 4; i++) {
+    integrity_write(MoneyRegion, i, hand_record.starting_money[i]);
+    queue_anim_money(i, table.money[i]);
+  }
+  return true;
+}
+
+// Put the replayed hand's cards where the deal takes them from: the hole
+// cards go round the table twice, then the board
+void arrange_replay_deck() {
+  Card cards[13];
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 4; j++)
+      cards[i * 4 + j] = hand_record.hole[j][i];
+  }
+  for (int i = 0; i < 5; i++)
+    cards[8 + i] = hand_record.board[i];
+  // Swapping keeps the deck a permutation
+  for (int i = 0; i < 13; i++) {
+    for (int j = i; j < CARD_COUNT; j++) {
+      if (face_values[j] == cards[i]) {
+        face_values[j] = face_values[i];
+        face_values[i] = cards[i];
+        break;
+      }
+    }
+  }
+}
+
+// Take the seat's recorded action. Returns false if the history has a
+// different seat or street next, the replay has gone out of step
+bool play_replay_action(Seat seat) {
+  if (replay_action >= hand_record.action_count)
+    return false;
+  HistoryAction *action = &hand_record.actions[replay_action];
+  if (action->seat != seat || action->street != current_phase - PreFlop)
+    return false;
+  replay_action++;
+  switch (action->type) {
+  case HistoryFold:
+    fold(seat);
+    break;
+  case HistoryCall:
+    call(seat);
+    break;
+  case HistoryBet:
+    // Recorded chips include the call
+    bet(seat,
+        action->chips - (get_max_bet(&table) - table.current_bets[seat]));
+    break;
+  }
+  return true;
+}
+
+void check_replay_payout(Seat who) {
+  if (who != hand_record.winner || table.money[4] != hand_record.pot ||
+      replay_action != hand_record.action_count)
+    report_replay_mismatch();
+}
+
+// Move all money in the pot to specified player
+void payout(Seat who) {
+  stats_payout(who, table.folded);
+  if (replaying) {
+    check_replay_payout(who);
+  } else if (is_history_enabled() && !is_journal_recovering()) {
+    // Hands replayed from the journal were logged before the restart
+    for (int i = 0; i < 4; i++) {
+      hand_record.hole[i][0] = face_values[hands[i][0]];
+      hand_record.hole[i][1] = face_values[hands[i][1]];
+    }
+    for (int i = 0; i < 5; i++)
+      hand_record.board[i] = face_values[board[i]];
+    hand_record.winner = who;
+    hand_record.pot = table.money[4];
+    hand_record.winning_value = display_hand;
+    log_hand(&hand_record);
+  }
+  add_money(who, table.money[4]);
+  queue_anim_money(who, table.money[who]);
+  add_money(4, -table.money[4]);
+  queue_anim_money(4, 0);
+}
+
+// Deal card onto the board
+void deal_faceup(size_t card, size_t slot) {
+  board[slot] = card;
+  queue_anim_move(
+      card,
+      (Vector2){(float)WORLD_WIDTH / 2 + CARD_WIDTH * slot - (CARD_WIDTH * 2),
+                (float)WORLD_HEIGHT / 2},
+      180, 1);
+}
+
+void deal_player(size_t card, Seat seat, size_t slot) {
+  hands[seat][slot] = card;
+  Vector2 pos = HAND_POSITIONS[seat][slot];
+  switch (seat) {
+  case Bot1: {
+    queue_anim_move(card, pos, -90, -1);
+    break;
+  }
+  case Bot2: {
+    queue_anim_move(card, pos, 180, -1);
+    break;
+  }
+  case Bot3: {
+    queue_anim_move(card, pos, 90, -1);
+    break;
+  }
+  case Player: {
+    queue_anim_move(card, pos, 180, 1);
+    break;
+  }
+  }
+}
+
+// Event object
+typedef struct {
+  enum { AdvancePhase, AdvanceTurn } tag;
+  union {
+    GamePhase next_phase;
+    Seat next_turn;
+  } variant;
+} Event;
+// Event loop state
+static Event event_queue[EVENT_QUEUE_SIZE];
+static float last_event_start = 0;
+
+void update_event_queue_metrics() {
+  size_t depth = (event_queue_end + EVENT_QUEUE_SIZE - event_queue_start) %
+                 EVENT_QUEUE_SIZE;
+  metric_set(MetricGameQueueDepth, depth);
+  metric_max(MetricGameQueueHighWater, depth);
+}
+
+void queue_event(Event event) {
+  event_queue_end += 1;
+  event_queue_end %= EVENT_QUEUE_SIZE;
+  event_queue[event_queue_end] = event;
+  update_event_queue_metrics();
+}
+
+void queue_game_phase(GamePhase phase) {
+  queue_event((Event){.tag = AdvancePhase, .variant.next_phase = phase});
+}
+
+void queue_next_game_phase() {
+  switch (current_phase) {
+  case Shuffle:
+    queue_game_phase(PreFlop);
+    break;
+  case PreFlop:
+    queue_game_phase(Flop);
+    break;
+  case Flop:
+    queue_game_phase(Turn);
+    break;
+  case Turn:
+    queue_game_phase(River);
+    break;
+  case River:
+    queue_game_phase(Showdown);
+    break;
+  case Showdown:
+    queue_game_phase(Shuffle);
+    break;
+  }
+}
+
+void queue_turn_order() {
+  // Do not queue turns if someone is all in
+  for (int i = 0; i < 4; i++) {
+    if (!table.folded[i]) {
+      queue_event((Event){.tag = AdvanceTurn, .variant.next_turn = i});
+    }
+  }
+}
+
+// Set once the background integrity checks have reported. Until then the
+// game loop does not block waiting for input, so a detection is seen on the
+// next frame
+static atomic_bool integrity_checked = false;
+
+void post_integrity_result(int tampered) {
+  if (tampered)
+    report_integrity_violation();
+  atomic_store(&integrity_checked, true);
+}
+
+// Evaluate a hand, recording the call in the metrics and trace
+HandValue measure_evaluate_hand(Card hand[2], Card board[5]) {
+  uint64_t trace_start = trace_enabled ? trace_now() : 0;
+  uint64_t start = metrics_now();
+  HandValue value = evaluate_hand(hand, board);
+  metric_add(MetricEvaluatorNanoseconds, metrics_now() - start);
+  metric_add(MetricEvaluatorCalls, 1);
+  if (trace_enabled)
+    trace_span("evaluate_hand", "evaluator", trace_start, trace_now(), "value",
+               value, NULL, 0);
+  return value;
+}
+
+// Hole cards of a seat and the board cards dealt so far. Returns the number of
+// board cards
+size_t get_seat_cards(Seat seat, Card hole[2], Card board_values[5]) {
+  hole[0] = face_values[hands[seat][0]];
+  hole[1] = face_values[hands[seat][1]];
+  size_t board_count = 0;
+  if (current_phase >= Flop)
+    board_count = 3;
+  if (current_phase >= Turn)
+    board_count = 4;
+  if (current_phase >= River)
+    board_count = 5;
+  for (size_t i = 0; i < board_count; i++)
+    board_values[i] = face_values[board[i]];
+  return board_count;
+}
+
+// Players still in the hand besides `seat`, at least one
+size_t count_opponents(Seat seat) {
+  size_t opponents = 0;
+  for (int i = 0; i < 4; i++) {
+    if (i != seat && !table.folded[i])
+      opponents += 1;
+  }
+  return opponents == 0 ? 1 : opponents;
+}
+
+// What a seat can see of the table, for the bots
+BotView get_bot_view(Seat seat) {
+  BotView view = {};
+  view.seat = seat;
+  view.board_count = get_seat_cards(seat, view.hole, view.board);
+  view.pot = table.money[4];
+  view.to_call = get_max_bet(&table) - table.current_bets[seat];
+  view.stack = table.money[seat];
+  view.opponents = count_opponents(seat);
+  view.table = table;
+  for (int i = 0; i < 4; i++)
+    view.stats[i] = get_recent_seat_stats(i);
+  return view;
+}
+
+// Drop a bot decision that is still being made, its hand is over
+void cancel_pending_decision() {
+  if (pending_decision == NO_BOT_TICKET)
+    return;
+  cancel_bot_decision(pending_decision);
+  pending_decision = NO_BOT_TICKET;
+  metric_add(MetricBotDecisionsCancelled, 1);
+}
+
+// Decide for a bot seat. The decision is made on a worker thread when there
+// is one; returns false until it is ready so the frame can carry on
+bool get_bot_action(Seat seat, BotAction *action) {
+  if (pending_decision == NO_BOT_TICKET) {
+    BotView view = get_bot_view(seat);
+    pending_decision = submit_bot_decision(seat, &view);
+    if (pending_decision == NO_BOT_TICKET) {
+      *action = decide_bot_action(seat, &view);
+      return true;
+    }
+  }
+  if (!poll_bot_decision(pending_decision, action)) {
+    metric_add(MetricBotPendingFrames, 1);
+    return false;
+  }
+  pending_decision = NO_BOT_TICKET;
+  return true;
+}
+
+// The pressed button as an action
+bool get_player_action(BotAction *action) {
+  switch (button_choice) {
+  case NoButton:
+    return false;
+  case BetButton:
+    *action = (BotAction){BotBet, bet_spinner_value};
+    return true;
+  case CallButton:
+    *action = (BotAction){BotCall, 0};
+    return true;
+  case FoldButton:
+    *action = (BotAction){BotFold, 0};
+    return true;
+  }
+  return false;
+}
+
+void take_action(Seat seat, BotAction action) {
+  switch (action.type) {
+  case BotFold:
+    fold(seat);
+    break;
+  case BotCall:
+    call(seat);
+    break;
+  case BotBet:
+    bet(seat, action.amount);
+    break;
+  }
+}
+
+// The core game loop: execute the next event and pop it if finished
+void tick_game() {
+  // Tampering found by the integrity monitor or the startup checks
+  if (is_caught == 0 && is_integrity_violated()) {
+    event_queue_start = event_queue_end;
+    is_caught = 1;
+    cancel_pending_decision();
+  }
+  // Nothing is left to play once the replayed hands run out
+  if (replay_finished)
+    return;
+
+  if (event_queue_start == event_queue_end) {
+    is_caught = 1;
+  } else {
+    float current_time = GetTime();
+    uint64_t trace_start = trace_enabled ? trace_now() : 0;
+    size_t current_index = (event_queue_start + 1) % EVENT_QUEUE_SIZE;
+    Event current_ev = event_queue[current_index];
+    switch (current_ev.tag) {
+    case AdvancePhase: {
+      // Wait for animations to catch up
+      if (!is_animations_finished()) {
+        return;
+      }
+      current_phase = current_ev.variant.next_phase;
+      for (int i = 0; i < 4; i++)
+        integrity_write(BetsRegion, i, 0);
+      switch (current_phase) {
+      case Shuffle: {
+        for (int i = 0; i < CARD_COUNT; i++) {
+          queue_anim_move(i, DECK_POSITION, 0, -1);
+          queue_anim_wait(0.01);
+        }
+        for (int i = 0; i < CARD_COUNT; i += 16) {
+          queue_anim_move(i, DECK_POSITION, 180, -1.0);
+          queue_anim_wait(0.03);
+        }
+        display_hand = 0;
+        for (int i = 0; i < 4; i++)
+          table.folded[i] = false;
+        if (replaying && !load_replay_hand()) {
+          finish_replay();
+          return;
+        }
+        stats_hand_started();
+        queue_game_phase(PreFlop);
+        break;
+      }
+      case PreFlop:
+        if (replaying) {
+          arrange_replay_deck();
+        } else {
+          history_begin_hand(&hand_record, &table);
+          shuffle_face_values();
+        }
+        current_card = 0;
+        for (int i = 0; i < 2; i++) {
+          for (int j = 0; j < 4; j++) {
+            deal_player(current_card++, j, i);
+            queue_anim_wait(0.2);
+          }
+        }
+        queue_turn_order();
+        break;
+      case Flop:
+        for (int i = 0; i < 3; i++) {
+          deal_faceup(current_card++, i);
+          queue_anim_wait(0.2);
+        }
+        queue_turn_order();
+        break;
+      case Turn:
+        deal_faceup(current_card++, 3);
+        queue_turn_order();
+        break;
+      case River:
+        deal_faceup(current_card++, 4);
+        queue_turn_order();
+        break;
+      case Showdown: {
+        HandValue max_value = 0;
+        size_t winning_player = Player;
+        Card this_board[5] = {
+            face_values[board[0]], face_values[board[1]], face_values[board[2]],
+            face_values[board[3]], face_values[board[4]],
+        };
+        for (int i = 0; i < Player; i++) {
+          flip_card(hands[i][0]);
+          flip_card(hands[i][1]);
+          queue_anim_wait(0.2);
+          if (!table.folded[i]) {
+            Card this_hand[2] = {face_values[hands[i][0]],
+                                 face_values[hands[i][1]]};
+            HandValue this_value = measure_evaluate_hand(this_hand, this_board);
+            if (this_value > max_value) {
+              max_value = this_value;
+              winning_player = i;
+            }
+          }
+        }
+        display_hand = max_value;
+        payout(winning_player);
+        metric_add(MetricHandsPlayed, 1);
+        queue_anim_wait(5);
+        queue_next_game_phase();
+        break;
+      }
+      }
+      break;
+    }
+    case AdvanceTurn: {
+      Seat current_seat = current_ev.variant.next_turn;
+      if (table.folded[current_seat]) {
+        printf("Break\n");
+        break;
+      }
+      if (replaying) {
+        if (!play_replay_action(current_seat)) {
+          report_replay_mismatch();
+          finish_replay();
+          return;
+        }
+      } else {
+        BotAction action;
+        if (is_journal_recovering()) {
+          // The action taken before the restart
+          if (!read_journal_input(current_seat, &action))
+            return;
+        } else if (current_seat != Player) {
+          // AI strategy
+          if (!get_bot_action(current_seat, &action))
+            return;
+        } else {
+          if (!get_player_action(&action))
+            return;
+          button_choice = NoButton;
+        }
+        journal_input(current_seat, action);
+        take_action(current_seat, action);
+      }
+      // Player + last turn
+      if (current_seat == Player) {
+        // Determine if turn order should repeat
+        bool do_next_turn = false;
+        int32_t max_bet = 0;
+        for (int i = 0; i < 4; i++)
+          if (table.current_bets[i] > max_bet && !table.folded[i])
+            max_bet = table.current_bets[i];
+        for (int i = 0; i < 4; i++)
+          if (table.current_bets[i] < max_bet && !table.folded[i])
+            do_next_turn = true;
+        if (do_next_turn) {
+          queue_turn_order();
+        } else {
+          queue_next_game_phase();
+        }
+      }
+      queue_anim_wait(1);
+      break;
+    }
+    }
+    event_queue_start = current_index;
+    last_event_start = current_time;
+    if (current_ev.tag == AdvancePhase)
+      journal_event(JournalPhase, current_phase);
+    else
+      journal_event(JournalTurn, current_ev.variant.next_turn);
+    metric_add(MetricGameEvents, 1);
+    update_event_queue_metrics();
+    if (trace_enabled) {
+      if (current_ev.tag == AdvancePhase)
+        trace_span("AdvancePhase", "game", trace_start, trace_now(), "phase",
+                   current_phase, NULL, 0);
+      else
+        trace_span("AdvanceTurn", "game", trace_start, trace_now(), "seat",
+                   current_ev.variant.next_turn, "phase", current_phase);
+    }
+  }
+}
+
+// Frame pacing: render at full rate while something is moving, at a low rate
+// while waiting on an animation timer, and block on OS input events while the
+// table is waiting for the player
+#define ACTIVE_FPS 60
+#define IDLE_FPS 10
+typedef enum { PaceActive, PaceWaiting, PaceIdle } FramePacing;
+static FramePacing current_pacing = PaceActive;
+static size_t paced_frames = 0;
+static double pacing_start = 0;
+
+bool is_seat_broke() {
+  for (int i = 0; i < 4; i++) {
+    if (table.money[i] <= 0)
+      return true;
+  }
+  return false;
+}
+
+// Whether the next game event is the player's turn and no button is pressed
+bool is_waiting_for_player() {
+  if (event_queue_start == event_queue_end)
+    return false;
+  Event next_ev = event_queue[(event_queue_start + 1) % EVENT_QUEUE_SIZE];
+  return !replaying && !replay_finished && !is_journal_recovering() &&
+         next_ev.tag == AdvanceTurn &&
+         next_ev.variant.next_turn == Player && !table.folded[Player] &&
+         button_choice == NoButton;
+}
+
+void update_frame_pacing() {
+  FramePacing pacing = PaceActive;
+  int target_fps = ACTIVE_FPS;
+  float wait_remaining = get_anim_wait_remaining();
+  if (!is_canvas_animating() && wait_remaining != 0.0) {
+    if (wait_remaining > 0.0) {
+      // Wake up in time for the animation timer to expire
+      pacing = PaceWaiting;
+      target_fps = (int)ceilf(1.0 / wait_remaining);
+      if (target_fps < IDLE_FPS)
+        target_fps = IDLE_FPS;
+      if (target_fps > ACTIVE_FPS)
+        target_fps = ACTIVE_FPS;
+    } else if ((is_waiting_for_player() || replay_finished) &&
+               atomic_load(&integrity_checked)) {
+      pacing = PaceIdle;
+      target_fps = IDLE_FPS;
+    }
+  }
+  if (pacing == PaceIdle && current_pacing != PaceIdle)
+    EnableEventWaiting();
+  else if (pacing != PaceIdle && current_pacing == PaceIdle)
+    DisableEventWaiting();
+  current_pacing = pacing;
+  SetTargetFPS(target_fps);
+  paced_frames += 1;
+}
+
+// Average frames per second since the game loop started
+float get_effective_fps() {
+  double elapsed = GetTime() - pacing_start;
+  if (elapsed <= 0.0)
+    return 0.0;
+  return paced_frames / elapsed;
+}
+
+// Reset the table to a fresh game: full wallets, empty pot, and a shuffle
+// queued as the first event
+void init_game() {
+  cancel_pending_decision();
+  for (int i = 0; i < 4; i++) {
+    table.money[i] = 1000;
+    table.current_bets[i] = 0;
+    table.folded[i] = false;
+  }
+  table.money[4] = 0;
+  register_integrity_region(MoneyRegion, table.money, 5);
+  set_integrity_total(MoneyRegion, 4000);
+  register_integrity_region(BetsRegion, table.current_bets, 4);
+  reset_stats();
+  // Every game is shuffled from its own seed, drawn from the last game's, and
+  // the journal starts over with it. A game being recovered keeps the seed
+  // it was journaled with
+  if (!is_journal_recovering()) {
+    uint32_t seed = rand();
+    srand(seed);
+    journal_new_game(seed);
+  }
+  event_queue_start = event_queue_end = 0;
+  current_phase = Shuffle;
+  button_choice = NoButton;
+  is_caught = 0;
+  for (int i = 0; i < 4; i++) {
+    queue_anim_money(i, table.money[i]);
+  }
+  queue_game_phase(Shuffle);
+}
+
+// Play the journal's entries back, with animations disabled, so the table is
+// where it was before the restart. The journal carries on from there, or
+// starts over with a new game if the journaled one had ended
+void recover_from_journal() {
+  uint64_t start = metrics_now();
+  while (is_journal_recovering()) {
+    // Entries past the end of a game can not be played
+    if (is_caught) {
+      stop_journal_recovery();
+      break;
+    }
+    tick_game();
+  }
+  if (is_caught || event_queue_start == event_queue_end)
+    init_game();
+  printf("Recovered the table from the journal in %.1f ms\n",
+         (metrics_now() - start) / 1e6);
+}
+
+// Worker threads for bot decisions. Only one seat acts at a time, the second
+// worker picks up the next decision while a cancelled one runs out
+#define BOT_WORKERS 2
+
+void start_gameloop() {
+  // Initialize game state
+  init_face_values();
+  init_drawing();
+  // Journal the table, or bring it back from the journal after a restart
+  // A replay takes its actions from the history file, so it is not journaled
+  char *journal_path = getenv("HOLDEM_JOURNAL");
+  uint32_t seed = time(NULL);
+  if (journal_path != NULL && getenv("HOLDEM_REPLAY") != NULL) {
+    printf("HOLDEM_JOURNAL is ignored with HOLDEM_REPLAY\n");
+  } else if (journal_path != NULL) {
+    if (start_journal(journal_path, &seed))
+      srand(seed);
+    else
+      printf("Could not open journal %s\n", journal_path);
+  }
+  bool recovering = is_journal_recovering();
+  set_animations_enabled(!recovering);
+  init_game();
+  if (recovering) {
+    recover_from_journal();
+    set_animations_enabled(true);
+  }
+  start_bot_workers(BOT_WORKERS);
+  // Bots play a strategy from the offline solver when one is given
+  char *strategy_path = getenv("HOLDEM_CFR_STRATEGY");
+  if (strategy_path != NULL) {
+    if (load_cfr_strategy(strategy_path)) {
+      for (int i = 0; i < Player; i++)
+        set_bot_strategy(i, CfrStrategy);
+    } else {
+      printf("Could not load CFR strategy from %s\n", strategy_path);
+    }
+  }
+  // Or search each decision, with this many threads
+  char *mcts_threads = getenv("HOLDEM_MCTS_THREADS");
+  if (mcts_threads != NULL) {
+    set_mcts_threads(strtoul(mcts_threads, NULL, 10));
+    for (int i = 0; i < Player; i++)
+      set_bot_strategy(i, MctsStrategy);
+  }
+  // Start game loop
+  SetTargetFPS(ACTIVE_FPS);
+  pacing_start = GetTime();
+  char *trace_path = getenv("HOLDEM_TRACE");
+  if (trace_path != NULL)
+    init_trace(trace_path);
+  // Replay a history file at the speed of the animations, from hand
+  // HOLDEM_REPLAY_HAND on
+  char *replay_path = getenv("HOLDEM_REPLAY");
+  if (replay_path != NULL) {
+    char *first_hand = getenv("HOLDEM_REPLAY_HAND");
+    if (open_history(replay_path))
+      start_replay(first_hand != NULL ? strtoul(first_hand, NULL, 10) : 0,
+                   SIZE_MAX);
+    else
+      printf("Could not open hand history %s\n", replay_path);
+  }
+  // Log every hand, compressed unless HOLDEM_HISTORY_RAW is set
+  char *history_path = getenv("HOLDEM_HISTORY");
+  if (history_path != NULL &&
+      !start_history_writer(history_path, getenv("HOLDEM_HISTORY_RAW") == NULL))
+    printf("Could not open hand history %s\n", history_path);
+  start_metrics_exporter();
+  uint64_t frame_start = trace_now();
+  while (!WindowShouldClose()) {
+    if (trace_enabled) {
+      uint64_t now = trace_now();
+      trace_span("frame", "frame", frame_start, now, NULL, 0, NULL, 0);
+      frame_start = now;
+    }
+    profile_next_frame();
+    profile_begin(StageTick);
+    tick_game();
+    profile_end(StageTick);
+    run_integrity_monitor(GetTime());
+    update_frame_pacing();
+    draw();
+  }
+  printf("Canvas rendered %zu frames, skipped %zu frames\n",
+         get_frames_rendered(), get_frames_skipped());
+  printf("Effective frame rate: %.1f FPS\n", get_effective_fps());
+  char *profile_csv = getenv("HOLDEM_PROFILE_CSV");
+  if (profile_csv != NULL && !dump_profile_csv(profile_csv))
+    printf("Could not write frame profile to %s\n", profile_csv);
+  cancel_pending_decision();
+  stop_bot_workers();
+  unload_cfr_strategy();
+  flush_trace();
+  stop_history_writer();
+  close_history();
+  stop_journal();
+  stop_metrics_exporter();
+  CloseWindow();
+}
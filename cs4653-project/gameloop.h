@@ -1,4 +1,30 @@
-#ifndef GAMELOOP_H
-#define GAMELOOP_Hz
-void start_gameloop();
-#endif
+#ifndef GAMELOOP_H
+#define GAMELOOP_Hz
+#include <stdbool.h>
+#include <stddef.h>
+void start_gameloop();
+// Reset the table to a fresh game. start_gameloop() does this itself
+void init_game();
+// Execute the next game event, if it is ready
+void tick_game();
+// Replay `count` hands of the history file opened with open_history(),
+// starting at hand `first`, in place of the deal, the bots and the player.
+// Hands are replayed through the game code, at the speed of the animations
+// or at full speed with them disabled
+void start_replay(size_t first, size_t count);
+// Whether a replay has played all its hands or gone out of step with the
+// history
+bool is_replay_finished();
+// Replay the entries of the journal opened with start_journal(), with
+// animations disabled, after init_game()
+void recover_from_journal();
+// Whether the next game event is the player's turn and no button is pressed
+bool is_waiting_for_player();
+// Whether a seat has run out of money
+bool is_seat_broke();
+// Average frames per second since the game loop started
+float get_effective_fps();
+// Post the result of the background integrity checks to the game loop. Safe
+// to call from any thread
+void post_integrity_result(int tampered);
+#endif
@@ -0,0 +1,123 @@
+#include "bot.h"
+#include "cards.h"
+#include "drawing.h"
+#include "gameloop.h"
+#include "history.h"
+#include "journal.h"
+#include "metrics.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Headless benchmark driver. Plays a fixed number of hands with animations
+// disabled and no window, using a scripted player, and prints the hands per
+// second. A new table is started whenever a seat runs out of money. With the
+// same seed every run plays exactly the same hands, which is what the PGO
+// build uses as its training workload.
+//
+// usage: headless [hands] [seed]
+//
+// HOLDEM_HISTORY logs the hands played, as in the game. HOLDEM_REPLAY replays
+// `hands` hands of a history file instead, from hand HOLDEM_REPLAY_HAND on,
+// and reports any that play out differently. HOLDEM_JOURNAL journals the
+// table, and a run with a journal that has entries first brings the table
+// back from it; the hands it replays count towards `hands`. A replay can not
+// be journaled.
+
+#define DEFAULT_HANDS 2000
+#define DEFAULT_SEED 4653
+
+// The scripted player has its own generator, so the shuffles that rand()
+// makes are the same with its turns taken from a journal
+static unsigned int player_seed = DEFAULT_SEED;
+
+// Scripted player: never folds, raises 10 about a quarter of the time and
+// calls otherwise
+void play_scripted_turn() {
+  if (rand_r(&player_seed) % 4 == 0) {
+    bet_spinner_value = 10;
+    button_choice = BetButton;
+  } else {
+    button_choice = CallButton;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t hands = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_HANDS;
+  unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_SEED;
+  player_seed = seed;
+  set_animations_enabled(false);
+  // Without a time limit the bots always sample the same runouts, so runs
+  // with the same seed play the same hands
+  set_bot_budget(UINT32_MAX);
+  init_face_values();
+  uint32_t table_seed = seed;
+  char *journal_path = getenv("HOLDEM_JOURNAL");
+  if (journal_path != NULL && getenv("HOLDEM_REPLAY") != NULL) {
+    printf("HOLDEM_JOURNAL can not be used with HOLDEM_REPLAY\n");
+    return 1;
+  }
+  if (journal_path != NULL && !start_journal(journal_path, &table_seed)) {
+    printf("Could not open journal %s\n", journal_path);
+    return 1;
+  }
+  srand(table_seed);
+  init_game();
+  if (is_journal_recovering())
+    recover_from_journal();
+  char *history_path = getenv("HOLDEM_HISTORY");
+  if (history_path != NULL &&
+      !start_history_writer(history_path, getenv("HOLDEM_HISTORY_RAW") == NULL))
+    printf("Could not open hand history %s\n", history_path);
+
+  char *replay_path = getenv("HOLDEM_REPLAY");
+  if (replay_path != NULL) {
+    if (!open_history(replay_path)) {
+      printf("Could not open hand history %s\n", replay_path);
+      return 1;
+    }
+    char *first_hand = getenv("HOLDEM_REPLAY_HAND");
+    start_replay(first_hand != NULL ? strtoul(first_hand, NULL, 10) : 0,
+                 hands);
+  }
+
+  // Hands brought back from the journal are not timed
+  size_t recovered = metric_get(MetricHandsPlayed);
+  size_t tables = 1;
+  uint64_t start = metrics_now();
+  size_t played = recovered;
+  while (played < hands && !is_replay_finished()) {
+    if (is_waiting_for_player())
+      play_scripted_turn();
+    tick_game();
+    // Once a seat runs out of money the hands left have next to nothing to
+    // bet, so start a new table after the hand that did it. A replay sets
+    // the stacks from the history instead. Tampering also ends a table
+    bool hand_over = (size_t)metric_get(MetricHandsPlayed) > played;
+    played = metric_get(MetricHandsPlayed);
+    if ((hand_over && replay_path == NULL && is_seat_broke()) || is_caught) {
+      init_game();
+      tables += 1;
+    }
+  }
+  double seconds = (metrics_now() - start) / 1e9;
+  stop_history_writer();
+  stop_journal();
+
+  hands = metric_get(MetricHandsPlayed) - recovered;
+  printf("Played %zu hands on %zu tables in %.3f s (seed %u)\n", hands, tables,
+         seconds, seed);
+  printf("%.0f hands/s\n", seconds > 0.0 ? hands / seconds : 0.0);
+  printf("Hand strength: %lld cached, %lld computed\n",
+         (long long)metric_get(MetricStrengthCacheHits),
+         (long long)metric_get(MetricStrengthCacheMisses));
+  if (replay_path != NULL)
+    printf("Replay: %lld hands out of step\n",
+           (long long)metric_get(MetricReplayMismatches));
+  if (history_path != NULL)
+    printf("History: %lld hands, %lld dropped, %lld bytes\n",
+           (long long)metric_get(MetricHistoryHands),
+           (long long)metric_get(MetricHistoryDropped),
+           (long long)metric_get(MetricHistoryBytes));
+  return 0;
+}
@@ -0,0 +1,933 @@
+#include "history.h"
+#include "metrics.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Finished hands waiting for the writer, a power of two
+#define HISTORY_QUEUE_SIZE 256
+// How often the writer looks for queued hands
+#define HISTORY_POLL_MICROSECONDS 10000
+// Longest a hand waits in a partly filled block, and between syncs
+#define HISTORY_FLUSH_NANOSECONDS 1000000000ull
+// Card slots in a record: hole cards, then the board
+#define RECORD_CARDS (SEAT_COUNT * 2 + 5)
+// Shortest match the compressor emits, and the size of its hash table
+#define MIN_MATCH 4
+#define MAX_MATCH (0x7f + MIN_MATCH)
+#define MATCH_HASH_BITS 12
+
+void history_begin_hand(HandRecord *record, const TableState *table) {
+  memset(record, 0, sizeof(*record));
+  for (size_t i = 0; i < SEAT_COUNT; i++)
+    record->starting_money[i] = table->money[i];
+}
+
+void history_add_action(HandRecord *record, size_t street, size_t seat,
+                        int32_t chips, bool raised) {
+  if (record->action_count == HISTORY_MAX_ACTIONS)
+    return;
+  HistoryAction *action = &record->actions[record->action_count++];
+  action->seat = seat;
+  action->street = street;
+  action->type = chips == FOLD_CHIPS ? HistoryFold
+                 : raised            ? HistoryBet
+                                     : HistoryCall;
+  action->chips = chips == FOLD_CHIPS ? 0 : chips;
+}
+
+size_t put_varint(uint8_t *out, uint64_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = value | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+bool get_varint(const uint8_t *data, size_t size, size_t *position,
+                uint64_t *value) {
+  *value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (*position >= size)
+      return false;
+    uint8_t byte = data[(*position)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (byte < 0x80)
+      return true;
+  }
+  return false;
+}
+
+// Signed numbers as varints, small magnitudes of either sign stay short
+uint64_t zigzag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return (value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// The street's highest bet less the seat's bet, from the actions so far
+int32_t street_to_call(const int32_t bets[SEAT_COUNT], size_t seat) {
+  int32_t max_bet = 0;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    if (bets[i] > max_bet)
+      max_bet = bets[i];
+  }
+  return max_bet - bets[seat];
+}
+
+size_t encode_hand_record(const HandRecord *record, const HandRecord *previous,
+                          uint8_t *out) {
+  static const HandRecord EMPTY = {};
+  if (previous == NULL)
+    previous = &EMPTY;
+  size_t length = 0;
+  length +=
+      put_varint(out + length, zigzag((int64_t)record->hand - previous->hand));
+  for (size_t i = 0; i < SEAT_COUNT; i++)
+    length += put_varint(out + length,
+                         zigzag((int64_t)record->starting_money[i] -
+                                previous->starting_money[i]));
+
+  // Cards as 6 bit indices, 63 for a card that was never dealt
+  const Card *cards[RECORD_CARDS];
+  for (size_t i = 0; i < SEAT_COUNT * 2; i++)
+    cards[i] = &record->hole[i / 2][i % 2];
+  for (size_t i = 0; i < 5; i++)
+    cards[SEAT_COUNT * 2 + i] = &record->board[i];
+  uint32_t bits = 0;
+  unsigned bit_count = 0;
+  for (size_t i = 0; i < RECORD_CARDS; i++) {
+    int index = card_index(*cards[i]);
+    bits |= (uint32_t)(index < 0 ? 63 : index) << bit_count;
+    bit_count += 6;
+    while (bit_count >= 8) {
+      out[length++] = bits;
+      bits >>= 8;
+      bit_count -= 8;
+    }
+  }
+  if (bit_count > 0)
+    out[length++] = bits;
+
+  size_t next = 0;
+  for (size_t street = 0; street < STREET_COUNT; street++) {
+    size_t first = next;
+    while (next < record->action_count &&
+           record->actions[next].street == street)
+      next++;
+    length += put_varint(out + length, next - first);
+    // Types are checked against the call as the decoder will compute it, a
+    // call of anything else is stored as a bet
+    int32_t bets[SEAT_COUNT] = {};
+    int32_t raises[HISTORY_MAX_ACTIONS];
+    uint8_t nibbles[HISTORY_MAX_ACTIONS];
+    for (size_t i = first; i < next; i++) {
+      const HistoryAction *action = &record->actions[i];
+      int32_t to_call = street_to_call(bets, action->seat);
+      uint8_t type = action->type;
+      if (type == HistoryCall && action->chips != to_call)
+        type = HistoryBet;
+      raises[i - first] = action->chips - to_call;
+      nibbles[i - first] = action->seat << 2 | type;
+      bets[action->seat] += action->chips;
+    }
+    for (size_t i = 0; i < next - first; i += 2)
+      out[length++] =
+          nibbles[i] | (i + 1 < next - first ? nibbles[i + 1] << 4 : 0);
+    for (size_t i = 0; i < next - first; i++) {
+      if ((nibbles[i] & 3) == HistoryBet)
+        length += put_varint(out + length, zigzag(raises[i]));
+    }
+  }
+
+  length += put_varint(out + length, record->winner);
+  length += put_varint(out + length, record->pot);
+  length += put_varint(out + length, record->winning_value);
+  return length;
+}
+
+size_t decode_hand_record(const uint8_t *data, size_t size,
+                          const HandRecord *previous, HandRecord *record) {
+  static const HandRecord EMPTY = {};
+  if (previous == NULL)
+    previous = &EMPTY;
+  memset(record, 0, sizeof(*record));
+  size_t position = 0;
+  uint64_t value;
+  if (!get_varint(data, size, &position, &value))
+    return 0;
+  record->hand = previous->hand + unzigzag(value);
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    if (!get_varint(data, size, &position, &value))
+      return 0;
+    record->starting_money[i] = previous->starting_money[i] + unzigzag(value);
+  }
+
+  Card *cards[RECORD_CARDS];
+  for (size_t i = 0; i < SEAT_COUNT * 2; i++)
+    cards[i] = &record->hole[i / 2][i % 2];
+  for (size_t i = 0; i < 5; i++)
+    cards[SEAT_COUNT * 2 + i] = &record->board[i];
+  uint32_t bits = 0;
+  unsigned bit_count = 0;
+  for (size_t i = 0; i < RECORD_CARDS; i++) {
+    while (bit_count < 6) {
+      if (position >= size)
+        return 0;
+      bits |= (uint32_t)data[position++] << bit_count;
+      bit_count += 8;
+    }
+    int index = bits & 63;
+    *cards[i] = index < CARD_COUNT ? index_card(index) : 0;
+    bits >>= 6;
+    bit_count -= 6;
+  }
+
+  for (size_t street = 0; street < STREET_COUNT; street++) {
+    uint64_t count;
+    if (!get_varint(data, size, &position, &count) ||
+        count > HISTORY_MAX_ACTIONS - record->action_count ||
+        (count + 1) / 2 > size - position)
+      return 0;
+    HistoryAction *actions = &record->actions[record->action_count];
+    for (size_t i = 0; i < count; i++) {
+      uint8_t nibble = data[position + i / 2] >> (i % 2 * 4) & 0xf;
+      actions[i].seat = nibble >> 2;
+      actions[i].type = nibble & 3;
+      actions[i].street = street;
+      if (actions[i].type > HistoryBet)
+        return 0;
+    }
+    position += (count + 1) / 2;
+    int32_t bets[SEAT_COUNT] = {};
+    for (size_t i = 0; i < count; i++) {
+      HistoryAction *action = &actions[i];
+      int32_t to_call = street_to_call(bets, action->seat);
+      if (action->type == HistoryCall)
+        action->chips = to_call;
+      if (action->type == HistoryBet) {
+        if (!get_varint(data, size, &position, &value))
+          return 0;
+        action->chips = to_call + unzigzag(value);
+      }
+      bets[action->seat] += action->chips;
+    }
+    record->action_count += count;
+  }
+
+  uint64_t winner, pot, winning_value;
+  if (!get_varint(data, size, &position, &winner) ||
+      !get_varint(data, size, &position, &pot) ||
+      !get_varint(data, size, &position, &winning_value) ||
+      winner >= SEAT_COUNT)
+    return 0;
+  record->winner = winner;
+  record->pot = pot;
+  record->winning_value = winning_value;
+  return position;
+}
+
+// Emit the literals from `start` to `end`. Returns false if the output would
+// not be smaller than the input of `size` bytes
+bool emit_literals(const uint8_t *in, size_t start, size_t end, size_t size,
+                   uint8_t *out, size_t *length) {
+  while (start < end) {
+    size_t run = end - start > 0x80 ? 0x80 : end - start;
+    if (*length + 1 + run >= size)
+      return false;
+    out[(*length)++] = run - 1;
+    memcpy(out + *length, in + start, run);
+    *length += run;
+    start += run;
+  }
+  return true;
+}
+
+// Tokens are a byte below 0x80 followed by that many literals plus one, or a
+// byte from 0x80 giving a match of its low bits plus MIN_MATCH bytes,
+// followed by the 16 bit distance back to the match
+size_t compress_block(const uint8_t *in, size_t size, uint8_t *out) {
+  int32_t heads[1 << MATCH_HASH_BITS];
+  for (size_t i = 0; i < 1 << MATCH_HASH_BITS; i++)
+    heads[i] = -1;
+  size_t length = 0;
+  size_t literal_start = 0;
+  size_t position = 0;
+  while (position + MIN_MATCH <= size) {
+    uint32_t word;
+    memcpy(&word, in + position, sizeof(word));
+    size_t hash = (word * 2654435761u) >> (32 - MATCH_HASH_BITS);
+    int32_t candidate = heads[hash];
+    heads[hash] = position;
+    if (candidate < 0 || position - candidate > UINT16_MAX ||
+        memcmp(in + candidate, in + position, MIN_MATCH) != 0) {
+      position++;
+      continue;
+    }
+    size_t match = MIN_MATCH;
+    while (match < MAX_MATCH && position + match < size &&
+           in[candidate + match] == in[position + match])
+      match++;
+    if (!emit_literals(in, literal_start, position, size, out, &length) ||
+        length + 3 >= size)
+      return 0;
+    size_t distance = position - candidate;
+    out[length++] = 0x80 | (match - MIN_MATCH);
+    out[length++] = distance;
+    out[length++] = distance >> 8;
+    position += match;
+    literal_start = position;
+  }
+  if (!emit_literals(in, literal_start, size, size, out, &length))
+    return 0;
+  return length;
+}
+
+size_t decompress_block(const uint8_t *in, size_t size, uint8_t *out,
+                        size_t out_size) {
+  size_t position = 0;
+  size_t length = 0;
+  while (position < size) {
+    uint8_t token = in[position++];
+    if (token < 0x80) {
+      size_t run = token + 1;
+      if (run > size - position || run > out_size - length)
+        return 0;
+      memcpy(out + length, in + position, run);
+      position += run;
+      length += run;
+      continue;
+    }
+    if (size - position < 2)
+      return 0;
+    size_t match = (token & 0x7f) + MIN_MATCH;
+    size_t distance = in[position] | in[position + 1] << 8;
+    position += 2;
+    if (distance == 0 || distance > length || match > out_size - length)
+      return 0;
+    // Byte by byte, a match may overlap the bytes it produces
+    for (size_t i = 0; i < match; i++, length++)
+      out[length] = out[length - distance];
+  }
+  return length == out_size ? length : 0;
+}
+
+#ifndef _WIN32
+// Bounded multi-producer queue of finished hands. Each slot's sequence number
+// tells whether it is free for the producer at that position or filled for
+// the writer, so neither side ever takes a lock
+typedef struct {
+  atomic_size_t sequence;
+  HandRecord record;
+} QueueSlot;
+
+static QueueSlot queue[HISTORY_QUEUE_SIZE];
+static atomic_size_t enqueue_position = 0;
+static size_t dequeue_position = 0;
+static atomic_uint_fast32_t next_hand = 0;
+
+static pthread_t writer_thread;
+static atomic_bool writer_running = false;
+static atomic_bool writer_stop = false;
+static int history_fd = -1;
+static bool compress_blocks = false;
+
+// Block being filled by the writer
+static uint8_t block[HISTORY_BLOCK_SIZE];
+static uint8_t compressed[HISTORY_BLOCK_SIZE];
+static HistoryBlockHeader block_header;
+static HandRecord previous_record;
+
+bool enqueue_hand(const HandRecord *record) {
+  size_t position =
+      atomic_load_explicit(&enqueue_position, memory_order_relaxed);
+  QueueSlot *slot;
+  for (;;) {
+    slot = &queue[position % HISTORY_QUEUE_SIZE];
+    size_t sequence =
+        atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(&enqueue_position, &position,
+                                                position + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (difference < 0) {
+      // The writer has not emptied this slot yet, the queue is full
+      return false;
+    } else {
+      position =
+          atomic_load_explicit(&enqueue_position, memory_order_relaxed);
+    }
+  }
+  slot->record = *record;
+  atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+  return true;
+}
+
+bool dequeue_hand(HandRecord *record) {
+  QueueSlot *slot = &queue[dequeue_position % HISTORY_QUEUE_SIZE];
+  size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+  if (sequence != dequeue_position + 1)
+    return false;
+  *record = slot->record;
+  atomic_store_explicit(&slot->sequence,
+                        dequeue_position + HISTORY_QUEUE_SIZE,
+                        memory_order_release);
+  dequeue_position++;
+  return true;
+}
+
+bool write_all(const struct iovec *parts, int count) {
+  struct iovec remaining[2];
+  memcpy(remaining, parts, count * sizeof(*parts));
+  struct iovec *part = remaining;
+  while (count > 0) {
+    ssize_t written = writev(history_fd, part, count);
+    if (written < 0)
+      return false;
+    metric_add(MetricHistoryBytes, written);
+    while (count > 0 && (size_t)written >= part->iov_len) {
+      written -= part->iov_len;
+      part++;
+      count--;
+    }
+    if (count > 0) {
+      part->iov_base = (uint8_t *)part->iov_base + written;
+      part->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// Write the block being filled, compressed if that makes it smaller
+void flush_block() {
+  if (block_header.records == 0)
+    return;
+  const uint8_t *payload = block;
+  block_header.stored_size = block_header.raw_size;
+  if (compress_blocks) {
+    size_t size = compress_block(block, block_header.raw_size, compressed);
+    if (size > 0) {
+      payload = compressed;
+      block_header.stored_size = size;
+    }
+  }
+  struct iovec parts[2] = {
+      {.iov_base = &block_header, .iov_len = sizeof(block_header)},
+      {.iov_base = (void *)payload, .iov_len = block_header.stored_size},
+  };
+  if (!write_all(parts, 2))
+    perror("Could not write hand history");
+  memset(&block_header, 0, sizeof(block_header));
+}
+
+void append_hand(const HandRecord *record) {
+  uint8_t encoded[HISTORY_RECORD_MAX];
+  uint8_t prefix[8];
+  bool first = block_header.records == 0;
+  size_t length =
+      encode_hand_record(record, first ? NULL : &previous_record, encoded);
+  size_t prefix_length = put_varint(prefix, length);
+  // A new block restarts the deltas
+  if (block_header.raw_size + prefix_length + length > HISTORY_BLOCK_SIZE) {
+    flush_block();
+    length = encode_hand_record(record, NULL, encoded);
+    prefix_length = put_varint(prefix, length);
+  }
+  if (block_header.records == 0)
+    block_header.first_hand = record->hand;
+  memcpy(block + block_header.raw_size, prefix, prefix_length);
+  memcpy(block + block_header.raw_size + prefix_length, encoded, length);
+  block_header.raw_size += prefix_length + length;
+  block_header.records++;
+  previous_record = *record;
+  metric_add(MetricHistoryHands, 1);
+}
+
+// Drain the queue into blocks. A block is written when it is full or its
+// first hand has waited long enough, and the file is synced at most that
+// often, so a busy table costs one write per block and a quiet one loses at
+// most a second of hands to a crash
+void *run_history_writer(void *arg) {
+  uint64_t block_started = 0;
+  uint64_t last_sync = metrics_now();
+  bool unsynced = false;
+  for (;;) {
+    bool stopping = atomic_load(&writer_stop);
+    HandRecord record;
+    while (dequeue_hand(&record)) {
+      if (block_header.records == 0)
+        block_started = metrics_now();
+      append_hand(&record);
+    }
+    uint64_t now = metrics_now();
+    if (block_header.records > 0 &&
+        (stopping || now - block_started >= HISTORY_FLUSH_NANOSECONDS)) {
+      flush_block();
+      unsynced = true;
+    }
+    if (unsynced &&
+        (stopping || now - last_sync >= HISTORY_FLUSH_NANOSECONDS)) {
+      fsync(history_fd);
+      last_sync = now;
+      unsynced = false;
+    }
+    if (stopping)
+      return NULL;
+    usleep(HISTORY_POLL_MICROSECONDS);
+  }
+}
+
+// Number of the last hand in a block, decoded into the writer's buffers
+bool find_last_hand(size_t offset, const HistoryBlockHeader *header,
+                    uint32_t *hand) {
+  if (pread(history_fd, compressed, header->stored_size,
+            offset + sizeof(*header)) != (ssize_t)header->stored_size)
+    return false;
+  const uint8_t *payload = compressed;
+  if (header->stored_size != header->raw_size) {
+    if (decompress_block(compressed, header->stored_size, block,
+                         header->raw_size) == 0)
+      return false;
+    payload = block;
+  }
+  size_t position = 0;
+  HandRecord previous = {};
+  HandRecord record;
+  for (size_t i = 0; i < header->records; i++) {
+    uint64_t length;
+    if (!get_varint(payload, header->raw_size, &position, &length) ||
+        length > header->raw_size - position ||
+        decode_hand_record(payload + position, length, &previous, &record) !=
+            length)
+      return false;
+    position += length;
+    previous = record;
+  }
+  *hand = record.hand;
+  return true;
+}
+
+// Check the file is a hand history, or make it one if it is empty, and find
+// where it ends. A block cut short by a crash is cut off so new blocks follow
+// whole ones. Sets `next` past the last hand in the file, so hand numbers
+// carry on from an earlier run
+bool prepare_history_file(uint32_t *next) {
+  struct stat info;
+  if (fstat(history_fd, &info) != 0)
+    return false;
+  *next = 0;
+  size_t size = info.st_size;
+  HistoryFileHeader file_header = {.magic = HISTORY_MAGIC,
+                                   .version = HISTORY_FORMAT_VERSION};
+  if (size == 0) {
+    struct iovec part = {.iov_base = &file_header,
+                         .iov_len = sizeof(file_header)};
+    return write_all(&part, 1);
+  }
+  HistoryFileHeader existing;
+  if (size < sizeof(existing) ||
+      pread(history_fd, &existing, sizeof(existing), 0) != sizeof(existing) ||
+      existing.magic != file_header.magic ||
+      existing.version != file_header.version)
+    return false;
+  size_t offset = sizeof(existing);
+  size_t last_offset = 0;
+  HistoryBlockHeader header;
+  HistoryBlockHeader last = {};
+  while (size - offset >= sizeof(header) &&
+         pread(history_fd, &header, sizeof(header), offset) ==
+             sizeof(header) &&
+         header.raw_size <= HISTORY_BLOCK_SIZE &&
+         header.stored_size <= header.raw_size &&
+         header.stored_size <= size - offset - sizeof(header)) {
+    last = header;
+    last_offset = offset;
+    offset += sizeof(header) + header.stored_size;
+  }
+  if (offset < size && ftruncate(history_fd, offset) != 0)
+    return false;
+  if (last.records == 0)
+    return true;
+  // Dropped hands leave gaps in the numbers, so the count of the block's
+  // hands is only a fallback
+  uint32_t hand;
+  *next = last.first_hand + last.records;
+  if (find_last_hand(last_offset, &last, &hand))
+    *next = hand + 1;
+  return true;
+}
+
+bool start_history_writer(const char *path, bool compress) {
+  if (atomic_load(&writer_running))
+    return false;
+  history_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (history_fd < 0)
+    return false;
+  uint32_t next;
+  if (!prepare_history_file(&next)) {
+    close(history_fd);
+    history_fd = -1;
+    return false;
+  }
+  atomic_store(&next_hand, next);
+  for (size_t i = 0; i < HISTORY_QUEUE_SIZE; i++)
+    atomic_store(&queue[i].sequence, i);
+  atomic_store(&enqueue_position, 0);
+  dequeue_position = 0;
+  memset(&block_header, 0, sizeof(block_header));
+  compress_blocks = compress;
+  atomic_store(&writer_stop, false);
+  if (pthread_create(&writer_thread, NULL, run_history_writer, NULL) != 0) {
+    close(history_fd);
+    history_fd = -1;
+    return false;
+  }
+  atomic_store(&writer_running, true);
+  return true;
+}
+
+void stop_history_writer() {
+  if (!atomic_load(&writer_running))
+    return;
+  atomic_store(&writer_running, false);
+  atomic_store(&writer_stop, true);
+  pthread_join(writer_thread, NULL);
+  close(history_fd);
+  history_fd = -1;
+}
+
+bool is_history_enabled() { return atomic_load(&writer_running); }
+
+void log_hand(HandRecord *record) {
+  if (!atomic_load(&writer_running))
+    return;
+  record->hand = atomic_fetch_add(&next_hand, 1);
+  if (!enqueue_hand(record))
+    metric_add(MetricHistoryDropped, 1);
+}
+#else
+// No writer thread on Windows, hands are not logged
+bool start_history_writer(const char *path, bool compress) { return false; }
+
+void stop_history_writer() {}
+
+bool is_history_enabled() { return false; }
+
+void log_hand(HandRecord *record) {}
+#endif
+
+// Reader state. The index is either mapped from its file or built in memory
+static const uint8_t *history_data = NULL;
+static size_t history_size = 0;
+static const uint8_t *index_data = NULL;
+static size_t index_size = 0;
+static bool index_mapped = false;
+static const HistoryIndexHeader *index_header = NULL;
+static const uint64_t *block_offsets = NULL;
+static const HistoryKeyframe *keyframes = NULL;
+// Last block decompressed for reading
+static uint8_t read_block[HISTORY_BLOCK_SIZE];
+static int64_t read_block_number = -1;
+
+#ifndef _WIN32
+const uint8_t *map_file(const char *path, size_t *size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat info;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+    data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+  *size = info.st_size;
+  return data;
+}
+
+void unmap_file(const uint8_t *data, size_t size) {
+  munmap((void *)data, size);
+}
+#else
+// No mmap on Windows, the file is read into memory
+const uint8_t *map_file(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = length > 0 ? malloc(length) : NULL;
+  if (data != NULL && fread(data, 1, length, file) != (size_t)length) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  *size = length;
+  return data;
+}
+
+void unmap_file(const uint8_t *data, size_t size) { free((void *)data); }
+#endif
+
+// Raw payload of the block whose header is at `offset`, decompressed into
+// `scratch` if it is stored compressed. Returns NULL if the block does not
+// fit in the file or does not decompress
+const uint8_t *get_block_payload(size_t offset, HistoryBlockHeader *header,
+                                 uint8_t *scratch) {
+  if (offset > history_size || history_size - offset < sizeof(*header))
+    return NULL;
+  memcpy(header, history_data + offset, sizeof(*header));
+  const uint8_t *stored = history_data + offset + sizeof(*header);
+  if (header->raw_size > HISTORY_BLOCK_SIZE ||
+      header->stored_size > header->raw_size ||
+      header->stored_size > history_size - offset - sizeof(*header))
+    return NULL;
+  if (header->stored_size == header->raw_size)
+    return stored;
+  if (decompress_block(stored, header->stored_size, scratch,
+                       header->raw_size) == 0)
+    return NULL;
+  return scratch;
+}
+
+// Scan the whole file for the index. A block that is cut short or does not
+// decode ends the scan, the writer may have been stopped in the middle of it
+bool build_history_index(const char *index_path) {
+  size_t block_capacity = 64;
+  size_t keyframe_capacity = 1024;
+  uint64_t *offsets = malloc(block_capacity * sizeof(*offsets));
+  HistoryKeyframe *frames = malloc(keyframe_capacity * sizeof(*frames));
+  size_t blocks = 0;
+  size_t frame_count = 0;
+  size_t hands = 0;
+  size_t offset = sizeof(HistoryFileHeader);
+  while (offset < history_size) {
+    HistoryBlockHeader header;
+    const uint8_t *payload = get_block_payload(offset, &header, read_block);
+    if (payload == NULL)
+      break;
+    size_t block_hands = hands;
+    size_t block_frames = frame_count;
+    size_t position = 0;
+    HandRecord previous = {};
+    HandRecord record;
+    bool valid = true;
+    for (size_t i = 0; i < header.records && valid; i++) {
+      if (hands % HISTORY_KEYFRAME_INTERVAL == 0) {
+        if (frame_count == keyframe_capacity) {
+          keyframe_capacity *= 2;
+          frames = realloc(frames, keyframe_capacity * sizeof(*frames));
+        }
+        HistoryKeyframe *frame = &frames[frame_count++];
+        frame->block = blocks;
+        frame->position = position;
+        frame->previous_hand = previous.hand;
+        memcpy(frame->previous_money, previous.starting_money,
+               sizeof(frame->previous_money));
+      }
+      uint64_t length;
+      valid = get_varint(payload, header.raw_size, &position, &length) &&
+              length <= header.raw_size - position &&
+              decode_hand_record(payload + position, length, &previous,
+                                 &record) == length;
+      position += length;
+      previous = record;
+      hands++;
+    }
+    if (!valid || position != header.raw_size) {
+      hands = block_hands;
+      frame_count = block_frames;
+      break;
+    }
+    if (blocks == block_capacity) {
+      block_capacity *= 2;
+      offsets = realloc(offsets, block_capacity * sizeof(*offsets));
+    }
+    offsets[blocks++] = offset;
+    offset += sizeof(header) + header.stored_size;
+  }
+  read_block_number = -1;
+
+  HistoryIndexHeader header = {.magic = HISTORY_INDEX_MAGIC,
+                               .version = HISTORY_INDEX_VERSION,
+                               .history_size = history_size,
+                               .hands = hands,
+                               .blocks = blocks,
+                               .keyframe_interval = HISTORY_KEYFRAME_INTERVAL};
+  size_t offsets_size = blocks * sizeof(*offsets);
+  size_t frames_size = frame_count * sizeof(*frames);
+  index_size = sizeof(header) + offsets_size + frames_size;
+  uint8_t *data = malloc(index_size);
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sizeof(header), offsets, offsets_size);
+  memcpy(data + sizeof(header) + offsets_size, frames, frames_size);
+  free(offsets);
+  free(frames);
+  index_data = data;
+  index_mapped = false;
+
+  // Write to a temporary file and rename it, so a reader never maps a
+  // partial index
+  char temp_path[512];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", index_path);
+  FILE *file = fopen(temp_path, "wb");
+  if (file == NULL)
+    return false;
+  bool written = fwrite(data, 1, index_size, file) == index_size;
+  if (fclose(file) != 0 || !written)
+    return false;
+  return rename(temp_path, index_path) == 0;
+}
+
+// Whether the mapped index matches the history file and this format, and
+// every block and keyframe it lists is inside the file
+bool is_index_valid(const uint8_t *data, size_t size) {
+  const HistoryIndexHeader *header = (const HistoryIndexHeader *)data;
+  if (size < sizeof(*header) || header->magic != HISTORY_INDEX_MAGIC ||
+      header->version != HISTORY_INDEX_VERSION ||
+      header->history_size != history_size ||
+      header->keyframe_interval != HISTORY_KEYFRAME_INTERVAL)
+    return false;
+  size_t frame_count = (header->hands + HISTORY_KEYFRAME_INTERVAL - 1) /
+                       HISTORY_KEYFRAME_INTERVAL;
+  if (size != sizeof(*header) + header->blocks * sizeof(uint64_t) +
+                  frame_count * sizeof(HistoryKeyframe))
+    return false;
+  // Blocks follow each other, each with at least its header
+  const uint64_t *offsets = (const uint64_t *)(data + sizeof(*header));
+  uint64_t block_start = sizeof(HistoryFileHeader);
+  for (size_t i = 0; i < header->blocks; i++) {
+    if (offsets[i] < block_start || offsets[i] > history_size ||
+        history_size - offsets[i] < sizeof(HistoryBlockHeader))
+      return false;
+    block_start = offsets[i] + sizeof(HistoryBlockHeader);
+  }
+  const HistoryKeyframe *frames =
+      (const HistoryKeyframe *)(offsets + header->blocks);
+  for (size_t i = 0; i < frame_count; i++) {
+    if (frames[i].block >= header->blocks ||
+        frames[i].position >= HISTORY_BLOCK_SIZE)
+      return false;
+  }
+  return true;
+}
+
+bool open_history(const char *path) {
+  close_history();
+  history_data = map_file(path, &history_size);
+  if (history_data == NULL)
+    return false;
+  const HistoryFileHeader *file_header =
+      (const HistoryFileHeader *)history_data;
+  if (history_size < sizeof(*file_header) ||
+      file_header->magic != HISTORY_MAGIC ||
+      file_header->version != HISTORY_FORMAT_VERSION) {
+    close_history();
+    return false;
+  }
+  char index_path[512];
+  snprintf(index_path, sizeof(index_path), "%s.idx", path);
+  index_data = map_file(index_path, &index_size);
+  index_mapped = index_data != NULL;
+  if (index_data != NULL && !is_index_valid(index_data, index_size)) {
+    unmap_file(index_data, index_size);
+    index_data = NULL;
+  }
+  // An index that can not be saved still works for this run
+  if (index_data == NULL && !build_history_index(index_path))
+    printf("Could not write hand history index %s\n", index_path);
+  index_header = (const HistoryIndexHeader *)index_data;
+  block_offsets = (const uint64_t *)(index_data + sizeof(*index_header));
+  keyframes = (const HistoryKeyframe *)(block_offsets + index_header->blocks);
+  return true;
+}
+
+void close_history() {
+  if (index_data != NULL) {
+    if (index_mapped)
+      unmap_file(index_data, index_size);
+    else
+      free((void *)index_data);
+  }
+  if (history_data != NULL)
+    unmap_file(history_data, history_size);
+  history_data = NULL;
+  index_data = NULL;
+  index_header = NULL;
+  history_size = index_size = 0;
+  read_block_number = -1;
+}
+
+size_t get_history_hand_count() {
+  return index_header == NULL ? 0 : index_header->hands;
+}
+
+// Payload of an indexed block, kept decompressed until another is read
+const uint8_t *get_indexed_block(size_t block, HistoryBlockHeader *header) {
+  if (block >= index_header->blocks)
+    return NULL;
+  read_block_number = -1;
+  const uint8_t *payload =
+      get_block_payload(block_offsets[block], header, read_block);
+  if (payload == read_block)
+    read_block_number = block;
+  return payload;
+}
+
+bool read_history_hand(size_t index, HandRecord *record) {
+  if (index >= get_history_hand_count())
+    return false;
+  const HistoryKeyframe *frame = &keyframes[index / HISTORY_KEYFRAME_INTERVAL];
+  size_t block = frame->block;
+  HistoryBlockHeader header;
+  const uint8_t *payload;
+  if ((int64_t)block == read_block_number) {
+    memcpy(&header, history_data + block_offsets[block], sizeof(header));
+    payload = read_block;
+  } else {
+    payload = get_indexed_block(block, &header);
+  }
+  size_t position = frame->position;
+  HandRecord previous = {.hand = frame->previous_hand};
+  memcpy(previous.starting_money, frame->previous_money,
+         sizeof(previous.starting_money));
+  // Decode forward from the keyframe, into the next block if needed, which
+  // restarts the deltas
+  for (size_t i = index - index % HISTORY_KEYFRAME_INTERVAL;; i++) {
+    if (payload != NULL && position == header.raw_size) {
+      payload = get_indexed_block(++block, &header);
+      position = 0;
+      memset(&previous, 0, sizeof(previous));
+    }
+    uint64_t length;
+    if (payload == NULL ||
+        !get_varint(payload, header.raw_size, &position, &length) ||
+        length > header.raw_size - position ||
+        decode_hand_record(payload + position, length, &previous, record) !=
+            length)
+      return false;
+    if (i == index)
+      return true;
+    position += length;
+    previous = *record;
+  }
+}
@@ -0,0 +1,151 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+#include "cards.h"
+#include "rules.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hand history log. Every finished hand is encoded into a compact record and
+// handed to a background writer thread through a lock-free queue, so logging
+// never blocks the game loop: when the queue is full the record is dropped
+// and counted. The writer packs records into blocks, optionally compresses
+// them, and writes and syncs a batch of blocks at a time.
+//
+// File layout: a HistoryFileHeader, then blocks. A block is a
+// HistoryBlockHeader and its payload, which holds varint-length prefixed
+// records. Deltas restart at every block, so a block decodes on its own.
+//
+// A record is, with varints for all numbers:
+//   hand number, zigzag delta from the previous record in the block
+//   starting money of each seat, zigzag delta from the previous record
+//   the 8 hole cards and 5 board cards, 6 bits each
+//   for each street: the number of actions, the actions as a 4 bit seat and
+//   type each, then for each bet the chips above the call, zigzag
+//   winner, the pot, and the winning hand value
+// Calls carry no chips, they are the street's highest bet less the seat's
+// bet, tracked while decoding.
+
+#define HISTORY_MAGIC 0x54534848 // "HHST"
+#define HISTORY_FORMAT_VERSION 1
+// Raw payload of a block, small enough for 16 bit match offsets
+#define HISTORY_BLOCK_SIZE 65536
+// Longest encoded record
+#define HISTORY_RECORD_MAX 1024
+// Actions in one hand, more are not recorded
+#define HISTORY_MAX_ACTIONS 96
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+} HistoryFileHeader;
+
+typedef struct {
+  // Payload size before and after compression, equal if it is stored raw
+  uint32_t raw_size;
+  uint32_t stored_size;
+  uint32_t records;
+  // Hand number of the first record in the block
+  uint32_t first_hand;
+} HistoryBlockHeader;
+
+typedef enum { HistoryFold, HistoryCall, HistoryBet } HistoryActionType;
+
+typedef struct {
+  uint8_t seat;
+  uint8_t type;
+  uint8_t street;
+  // Chips put in, 0 for folds and checks
+  int32_t chips;
+} HistoryAction;
+
+typedef struct {
+  uint32_t hand;
+  int32_t starting_money[SEAT_COUNT];
+  Card hole[SEAT_COUNT][2];
+  Card board[5];
+  HistoryAction actions[HISTORY_MAX_ACTIONS];
+  size_t action_count;
+  size_t winner;
+  int32_t pot;
+  HandValue winning_value;
+} HandRecord;
+
+// Varints, shared with the journal. put_varint() writes at most 10 bytes
+size_t put_varint(uint8_t *out, uint64_t value);
+bool get_varint(const uint8_t *data, size_t size, size_t *position,
+                uint64_t *value);
+uint64_t zigzag(int64_t value);
+int64_t unzigzag(uint64_t value);
+
+// Building a record as the hand is played
+void history_begin_hand(HandRecord *record, const TableState *table);
+void history_add_action(HandRecord *record, size_t street, size_t seat,
+                        int32_t chips, bool raised);
+
+// Encode a record, with deltas against `previous` (NULL for the first record
+// of a block). Returns the bytes written, at most HISTORY_RECORD_MAX
+size_t encode_hand_record(const HandRecord *record, const HandRecord *previous,
+                          uint8_t *out);
+// Decode one record, `previous` as for encoding. Returns the bytes read, or 0
+// if the record is malformed
+size_t decode_hand_record(const uint8_t *data, size_t size,
+                          const HandRecord *previous, HandRecord *record);
+
+// Block compression, a byte oriented LZ77. Returns the compressed size, or 0
+// if it would not be smaller than the input
+size_t compress_block(const uint8_t *in, size_t size, uint8_t *out);
+// Returns the decompressed size, or 0 if the data is malformed or does not
+// decompress to exactly `out_size` bytes
+size_t decompress_block(const uint8_t *in, size_t size, uint8_t *out,
+                        size_t out_size);
+
+// Append finished hands to the file at `path`, creating it if needed. Hand
+// numbers carry on from the last hand already in the file. Returns false if
+// it can not be opened or is not a hand history
+bool start_history_writer(const char *path, bool compress);
+// Write everything queued and stop the writer
+void stop_history_writer();
+bool is_history_enabled();
+// Queue a finished hand. Never blocks; the hand number is assigned here
+void log_hand(HandRecord *record);
+
+// Reading. The history file is mapped into memory, with a side index in
+// `path`.idx that lists the blocks and a keyframe every
+// HISTORY_KEYFRAME_INTERVAL hands. A keyframe is where its hand's record
+// starts and the decoding state it needs, the previous record's hand number
+// and stacks, so reading any hand decodes at most HISTORY_KEYFRAME_INTERVAL
+// records of one block. The index is rebuilt when the file has grown since
+// it was written. Hands are counted from 0 at the start of the file.
+#define HISTORY_INDEX_MAGIC 0x58494848 // "HHIX"
+#define HISTORY_INDEX_VERSION 1
+#define HISTORY_KEYFRAME_INTERVAL 32
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  // Size of the history file when it was indexed
+  uint64_t history_size;
+  uint32_t hands;
+  uint32_t blocks;
+  uint32_t keyframe_interval;
+  uint32_t reserved;
+} HistoryIndexHeader;
+
+typedef struct {
+  uint32_t block;
+  // Offset of the record in the block's raw payload
+  uint32_t position;
+  uint32_t previous_hand;
+  int32_t previous_money[SEAT_COUNT];
+} HistoryKeyframe;
+
+// The index file is the header, the file offset of every block as a
+// uint64_t, then the keyframes
+bool open_history(const char *path);
+void close_history();
+size_t get_history_hand_count();
+// Decode the hand at `index`. Returns false if it is past the end
+bool read_history_hand(size_t index, HandRecord *record);
+
+#endif
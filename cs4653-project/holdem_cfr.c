@@ -0,0 +1,384 @@
+#include "cards.h"
+#include "cfr.h"
+#include "rules.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Offline CFR solver for the abstracted table in cfr.h. Trains with external
+// sampling Monte Carlo CFR: every iteration deals random cards, and each seat
+// in turn explores all of its own actions while the other seats sample one
+// action from their current strategy. Threads share the regret and strategy
+// tables and update them with atomic compare and swap, without locks. The
+// average strategy is exported as the strategy file the bots map at runtime.
+//
+// usage: holdem_cfr [options] strategy
+//   -i count  iterations, default 1000000
+//   -t count  worker threads, defaults to the number of CPUs
+//   -c path   checkpoint file, written every -e iterations
+//   -e count  iterations between checkpoints, default 100000
+//   -r path   resume from a checkpoint
+//   -s seed   random seed
+
+#define MAX_THREADS 64
+#define STARTING_MONEY 1000
+// Checkpoint file: a header, then the regrets and strategy sums as floats
+#define CHECKPOINT_MAGIC 0x43524643 // "CFRC"
+#define TABLE_SIZE (CFR_INFOSETS * CFR_ACTION_COUNT)
+
+// Cumulative regrets, kept at or above zero (regret matching+), and the sums
+// of every strategy played, whose normalization is the average strategy
+static _Atomic float regrets[TABLE_SIZE] = {};
+static _Atomic float strategy_sums[TABLE_SIZE] = {};
+
+// Cards of one iteration, with every seat's bucket on every street worked out
+// up front
+typedef struct {
+  size_t buckets[CFR_STREETS][SEAT_COUNT];
+  HandValue values[SEAT_COUNT];
+  uint64_t random;
+} Deal;
+
+typedef struct {
+  uint64_t iterations;
+  uint64_t seed;
+} Worker;
+
+// xorshift64
+uint64_t next_cfr_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+void add_float(_Atomic float *target, float amount, bool floor_at_zero) {
+  float old = atomic_load_explicit(target, memory_order_relaxed);
+  float new;
+  do {
+    new = old + amount;
+    if (floor_at_zero && new < 0.0)
+      new = 0.0;
+  } while (!atomic_compare_exchange_weak_explicit(
+      target, &old, new, memory_order_relaxed, memory_order_relaxed));
+}
+
+void deal_cards(Deal *deal) {
+  Card deck[CARD_COUNT];
+  for (int i = 0; i < CARD_COUNT; i++)
+    deck[i] = index_card(i);
+  // Partial shuffle: two hole cards per seat, then the board
+  size_t dealt = SEAT_COUNT * 2 + 5;
+  for (size_t i = 0; i < dealt; i++) {
+    size_t j = i + next_cfr_random(&deal->random) % (CARD_COUNT - i);
+    Card temp = deck[i];
+    deck[i] = deck[j];
+    deck[j] = temp;
+  }
+  const Card *board = deck + SEAT_COUNT * 2;
+  static const size_t BOARD_COUNTS[CFR_STREETS] = {0, 3, 4, 5};
+  for (size_t seat = 0; seat < SEAT_COUNT; seat++) {
+    const Card *hole = deck + seat * 2;
+    for (size_t street = 0; street < CFR_STREETS; street++)
+      deal->buckets[street][seat] =
+          cfr_bucket(hole, board, BOARD_COUNTS[street]);
+    Card cards[7] = {hole[0], hole[1]};
+    memcpy(cards + 2, board, 5 * sizeof(Card));
+    deal->values[seat] = evaluate_cards(cards, 7);
+  }
+}
+
+// Money `seat` ends the hand with, less the money it started with
+float payoff(const HandState *state, const Deal *deal, size_t seat) {
+  const TableState *table = &state->table;
+  float result = table->money[seat] - STARTING_MONEY;
+  if (table->folded[seat])
+    return result;
+  HandValue best = 0;
+  size_t winners = 0;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    if (table->folded[i])
+      continue;
+    if (deal->values[i] > best) {
+      best = deal->values[i];
+      winners = 0;
+    }
+    winners += deal->values[i] == best;
+  }
+  // A seat left alone wins without a showdown
+  if (count_in_hand(table) == 1 || deal->values[seat] == best)
+    result += (float)table->money[POT] /
+              (count_in_hand(table) == 1 ? 1 : winners);
+  return result;
+}
+
+size_t get_infoset(const HandState *state, const Deal *deal) {
+  static const size_t BOARD_COUNTS[CFR_STREETS] = {0, 3, 4, 5};
+  const TableState *table = &state->table;
+  BotView view = {};
+  view.seat = state->seat;
+  view.board_count = BOARD_COUNTS[state->street];
+  view.pot = table->money[POT];
+  view.to_call = get_max_bet(table) - table->current_bets[state->seat];
+  view.stack = table->money[state->seat];
+  view.opponents = count_in_hand(table) - 1;
+  return cfr_infoset(&view, deal->buckets[state->street][state->seat]);
+}
+
+// Current strategy of an information set, by regret matching
+void get_strategy(size_t infoset, float strategy[CFR_ACTION_COUNT]) {
+  float total = 0.0;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    strategy[i] = 0.0;
+    if (cfr_action_legal(infoset, i))
+      strategy[i] = atomic_load_explicit(
+          &regrets[infoset * CFR_ACTION_COUNT + i], memory_order_relaxed);
+    total += strategy[i];
+  }
+  float legal = 0.0;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++)
+    legal += cfr_action_legal(infoset, i);
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    if (total > 0.0)
+      strategy[i] /= total;
+    else
+      strategy[i] = cfr_action_legal(infoset, i) / legal;
+  }
+}
+
+// Value of the hand to `traverser` from this point
+float traverse(HandState state, Deal *deal, size_t traverser) {
+  if (!advance_hand(&state))
+    return payoff(&state, deal, traverser);
+  size_t infoset = get_infoset(&state, deal);
+  float strategy[CFR_ACTION_COUNT];
+  get_strategy(infoset, strategy);
+
+  if (state.seat != traverser) {
+    // Sample one action, and count it towards the average strategy
+    float roll = (next_cfr_random(&deal->random) >> 40) / (float)(1 << 24);
+    size_t chosen = CFR_ACTION_COUNT;
+    size_t last = 0;
+    for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+      if (strategy[i] <= 0.0)
+        continue;
+      add_float(&strategy_sums[infoset * CFR_ACTION_COUNT + i], strategy[i],
+                false);
+      if (chosen == CFR_ACTION_COUNT && roll < strategy[i])
+        chosen = i;
+      roll -= strategy[i];
+      last = i;
+    }
+    // Rounding can leave the roll just past the last action
+    if (chosen == CFR_ACTION_COUNT)
+      chosen = last;
+    apply_cfr_action(&state, chosen);
+    return traverse(state, deal, traverser);
+  }
+
+  float values[CFR_ACTION_COUNT] = {};
+  float node_value = 0.0;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    if (!cfr_action_legal(infoset, i))
+      continue;
+    HandState child = state;
+    apply_cfr_action(&child, i);
+    values[i] = traverse(child, deal, traverser);
+    node_value += strategy[i] * values[i];
+  }
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    if (cfr_action_legal(infoset, i))
+      add_float(&regrets[infoset * CFR_ACTION_COUNT + i],
+                values[i] - node_value, true);
+  }
+  return node_value;
+}
+
+void *run_worker(void *arg) {
+  Worker *worker = arg;
+  Deal deal = {.random = worker->seed | 1};
+  HandState start = {};
+  for (size_t i = 0; i < SEAT_COUNT; i++)
+    start.table.money[i] = STARTING_MONEY;
+  start.seat = SIZE_MAX;
+  for (uint64_t i = 0; i < worker->iterations; i++) {
+    deal_cards(&deal);
+    for (size_t traverser = 0; traverser < SEAT_COUNT; traverser++)
+      traverse(start, &deal, traverser);
+  }
+  return NULL;
+}
+
+// Write to a temporary file and rename it, so a crash never leaves a partial
+// file behind
+bool write_file(const char *path, const CfrHeader *header, const void *data,
+                size_t size) {
+  char temp_path[512];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+  FILE *file = fopen(temp_path, "wb");
+  if (file == NULL)
+    return false;
+  bool written = fwrite(header, sizeof(CfrHeader), 1, file) == 1 &&
+                 fwrite(data, 1, size, file) == size;
+  written &= fclose(file) == 0;
+  return written && rename(temp_path, path) == 0;
+}
+
+bool write_checkpoint(const char *path, uint64_t iterations) {
+  static float tables[TABLE_SIZE * 2];
+  for (size_t i = 0; i < TABLE_SIZE; i++) {
+    tables[i] = atomic_load(&regrets[i]);
+    tables[TABLE_SIZE + i] = atomic_load(&strategy_sums[i]);
+  }
+  CfrHeader header = {CHECKPOINT_MAGIC, CFR_FORMAT_VERSION, CFR_INFOSETS,
+                      CFR_ACTION_COUNT, CFR_BUCKETS,        iterations};
+  return write_file(path, &header, tables, sizeof(tables));
+}
+
+// Returns the iterations already trained, or -1 if the checkpoint is unusable
+int64_t read_checkpoint(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return -1;
+  static float tables[TABLE_SIZE * 2];
+  CfrHeader header;
+  bool read = fread(&header, sizeof(header), 1, file) == 1 &&
+              fread(tables, sizeof(tables), 1, file) == 1;
+  fclose(file);
+  if (!read || header.magic != CHECKPOINT_MAGIC ||
+      header.version != CFR_FORMAT_VERSION ||
+      header.infosets != CFR_INFOSETS || header.actions != CFR_ACTION_COUNT ||
+      header.buckets != CFR_BUCKETS)
+    return -1;
+  for (size_t i = 0; i < TABLE_SIZE; i++) {
+    atomic_store(&regrets[i], tables[i]);
+    atomic_store(&strategy_sums[i], tables[TABLE_SIZE + i]);
+  }
+  return header.iterations;
+}
+
+// Average strategy, scaled to 0-255 per action. Information sets that were
+// never reached are left at zero
+bool write_strategy(const char *path, uint64_t iterations, size_t *reached) {
+  static uint8_t probabilities[TABLE_SIZE];
+  *reached = 0;
+  for (size_t infoset = 0; infoset < CFR_INFOSETS; infoset++) {
+    _Atomic float *sums = &strategy_sums[infoset * CFR_ACTION_COUNT];
+    float total = 0.0;
+    for (size_t i = 0; i < CFR_ACTION_COUNT; i++)
+      total += atomic_load(&sums[i]);
+    *reached += total > 0.0;
+    for (size_t i = 0; i < CFR_ACTION_COUNT; i++)
+      probabilities[infoset * CFR_ACTION_COUNT + i] =
+          total > 0.0 ? (uint8_t)(atomic_load(&sums[i]) / total * 255 + 0.5)
+                      : 0;
+  }
+  CfrHeader header = {CFR_MAGIC,        CFR_FORMAT_VERSION, CFR_INFOSETS,
+                      CFR_ACTION_COUNT, CFR_BUCKETS,        iterations};
+  return write_file(path, &header, probabilities, sizeof(probabilities));
+}
+
+double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+  uint64_t iterations = 1000000;
+  uint64_t checkpoint_every = 100000;
+  uint64_t seed = 4653;
+  long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *checkpoint_path = NULL;
+  const char *resume_path = NULL;
+  const char *strategy_path = NULL;
+  bool usage_error = false;
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-i") == 0 && has_value)
+      iterations = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-t") == 0 && has_value)
+      thread_count = strtol(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-c") == 0 && has_value)
+      checkpoint_path = argv[++i];
+    else if (strcmp(argv[i], "-e") == 0 && has_value)
+      checkpoint_every = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-r") == 0 && has_value)
+      resume_path = argv[++i];
+    else if (strcmp(argv[i], "-s") == 0 && has_value)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if (argv[i][0] != '-' && strategy_path == NULL)
+      strategy_path = argv[i];
+    else
+      usage_error = true;
+  }
+  if (usage_error || strategy_path == NULL) {
+    fprintf(stderr, "usage: holdem_cfr [-i iterations] [-t threads] "
+                    "[-c checkpoint] [-e every] [-r checkpoint] [-s seed] "
+                    "strategy\n");
+    return 1;
+  }
+  if (thread_count < 1)
+    thread_count = 1;
+  if (thread_count > MAX_THREADS)
+    thread_count = MAX_THREADS;
+  if (checkpoint_every == 0)
+    checkpoint_every = iterations;
+
+  uint64_t done = 0;
+  if (resume_path != NULL) {
+    int64_t resumed = read_checkpoint(resume_path);
+    if (resumed < 0) {
+      fprintf(stderr, "holdem_cfr: could not resume from %s\n", resume_path);
+      return 1;
+    }
+    done = resumed;
+    printf("Resumed from %s after %llu iterations\n", resume_path,
+           (unsigned long long)done);
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t start_done = done;
+  // Train in rounds, checkpointing between them
+  while (done < iterations) {
+    uint64_t round = iterations - done;
+    if (round > checkpoint_every)
+      round = checkpoint_every;
+    pthread_t threads[MAX_THREADS];
+    Worker workers[MAX_THREADS];
+    for (long i = 0; i < thread_count; i++) {
+      workers[i].iterations =
+          round / thread_count + ((uint64_t)i < round % thread_count);
+      // Different for every thread and round, so a resumed run does not
+      // replay the deals it already trained on
+      workers[i].seed = (seed ^ (done * 0x9E3779B97F4A7C15ull)) +
+                        (i + 1) * 0xBF58476D1CE4E5B9ull;
+      pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+    for (long i = 0; i < thread_count; i++)
+      pthread_join(threads[i], NULL);
+    done += round;
+    double elapsed = seconds_since(&start);
+    printf("%llu iterations, %.0f iterations/s\n", (unsigned long long)done,
+           elapsed > 0.0 ? (done - start_done) / elapsed : 0.0);
+    if (checkpoint_path != NULL && !write_checkpoint(checkpoint_path, done))
+      fprintf(stderr, "holdem_cfr: could not write checkpoint %s\n",
+              checkpoint_path);
+  }
+
+  size_t reached;
+  if (!write_strategy(strategy_path, done, &reached)) {
+    fprintf(stderr, "holdem_cfr: could not write %s\n", strategy_path);
+    return 1;
+  }
+  printf("Wrote %s: %zu of %d information sets reached\n", strategy_path,
+         reached, CFR_INFOSETS);
+  return 0;
+}
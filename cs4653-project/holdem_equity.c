@@ -0,0 +1,409 @@
+#include "cards.h"
+#include "holdem_eval.h"
+#include "range.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Range versus range equity calculator. Each player's range is expanded into
+// its combos, and combos that clash with the board, dead cards or each other
+// are skipped using 52 bit card masks. Small problems are enumerated exactly;
+// large ones are sampled until the 95% confidence interval of every player's
+// equity is within the requested precision.
+//
+// usage: holdem_equity [options] range range [range [range]]
+//   -b cards   board cards already dealt, like "Ah7d2c"
+//   -d cards   dead cards
+//   -t count   worker threads, defaults to the number of CPUs
+//   -p percent confidence interval to stop sampling at, default 0.1
+//   -n count   most runouts to sample, default 100000000
+//   -s seed    random seed for sampling
+//   -x         always enumerate exactly
+//   -m         always sample
+
+#define MAX_PLAYERS 4
+#define MAX_THREADS 64
+// Problems with at most this many evaluations are enumerated exactly
+#define EXACT_LIMIT 200000000.0
+// Runouts each thread samples between checks of the confidence interval
+#define SAMPLE_BATCH 8192
+// Runouts sampled before the confidence interval is trusted
+#define MIN_SAMPLES 20000
+
+typedef struct {
+  Range ranges[MAX_PLAYERS];
+  size_t players;
+  Card board[5];
+  size_t board_count;
+  uint64_t board_mask;
+  // Sampling settings
+  double precision;
+  uint64_t max_samples;
+  uint64_t seed;
+} Problem;
+
+// Running totals of each player's share of the pot per runout
+typedef struct {
+  double shares[MAX_PLAYERS];
+  double squares[MAX_PLAYERS];
+  uint64_t runouts;
+} Tally;
+
+typedef struct {
+  const Problem *problem;
+  size_t thread_index;
+  size_t thread_count;
+  Tally tally;
+} Worker;
+
+// Shared sampling state
+static pthread_mutex_t tally_lock = PTHREAD_MUTEX_INITIALIZER;
+static Tally total = {};
+static atomic_bool sampling_done = false;
+
+// xorshift64
+uint64_t next_sample_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Score one runout: every player with the best hand gets an even share
+void score_board(const Combo **combos, size_t players, const Card board[5],
+                 Tally *tally) {
+  HandValue values[MAX_PLAYERS];
+  HandValue max_value = 0;
+  size_t winners = 0;
+  for (size_t i = 0; i < players; i++) {
+    Card cards[7] = {combos[i]->cards[0], combos[i]->cards[1], board[0],
+                     board[1],            board[2],            board[3],
+                     board[4]};
+    values[i] = evaluate_cards(cards, 7);
+    if (values[i] > max_value) {
+      max_value = values[i];
+      winners = 0;
+    }
+    if (values[i] == max_value)
+      winners += 1;
+  }
+  for (size_t i = 0; i < players; i++) {
+    double share = values[i] == max_value ? 1.0 / winners : 0.0;
+    tally->shares[i] += share;
+    tally->squares[i] += share * share;
+  }
+  tally->runouts += 1;
+}
+
+// Score every runout of the board for one set of combos
+void enumerate_boards(const Problem *problem, const Combo **combos,
+                      uint64_t used, Tally *tally) {
+  Card deck[CARD_COUNT];
+  size_t deck_count = 0;
+  for (int i = 0; i < CARD_COUNT; i++) {
+    if (!(used & (1ull << i)))
+      deck[deck_count++] = index_card(i);
+  }
+  Card board[5];
+  memcpy(board, problem->board, sizeof(board));
+  size_t missing = 5 - problem->board_count;
+  size_t picks[5];
+  for (size_t i = 0; i < missing; i++)
+    picks[i] = i;
+  while (true) {
+    for (size_t i = 0; i < missing; i++)
+      board[problem->board_count + i] = deck[picks[i]];
+    score_board(combos, problem->players, board, tally);
+    // Advance the rightmost pick that still has room
+    size_t i = missing;
+    while (i > 0 && picks[i - 1] == deck_count - missing + i - 1)
+      i--;
+    if (i == 0)
+      break;
+    picks[i - 1] += 1;
+    for (size_t j = i; j < missing; j++)
+      picks[j] = picks[j - 1] + 1;
+  }
+}
+
+// Pick a combo for `player` and every later player that does not clash with
+// the cards in `used`, enumerating the boards for every full set
+void enumerate_combos(const Problem *problem, size_t player,
+                      const Combo **combos, uint64_t used, Tally *tally) {
+  if (player == problem->players) {
+    enumerate_boards(problem, combos, used, tally);
+    return;
+  }
+  const Range *range = &problem->ranges[player];
+  for (size_t i = 0; i < range->count; i++) {
+    if (range->combos[i].mask & used)
+      continue;
+    combos[player] = &range->combos[i];
+    enumerate_combos(problem, player + 1, combos, used | combos[player]->mask,
+                     tally);
+  }
+}
+
+// Threads split the first player's combos between them
+void *run_exact(void *arg) {
+  Worker *worker = arg;
+  const Problem *problem = worker->problem;
+  const Combo *combos[MAX_PLAYERS];
+  const Range *first = &problem->ranges[0];
+  for (size_t i = worker->thread_index; i < first->count;
+       i += worker->thread_count) {
+    if (first->combos[i].mask & problem->board_mask)
+      continue;
+    combos[0] = &first->combos[i];
+    enumerate_combos(problem, 1, combos,
+                     problem->board_mask | combos[0]->mask, &worker->tally);
+  }
+  return NULL;
+}
+
+// Widest 95% confidence interval of any player's equity
+double confidence_interval(const Tally *tally, size_t players) {
+  double widest = 0.0;
+  for (size_t i = 0; i < players; i++) {
+    double mean = tally->shares[i] / tally->runouts;
+    double variance = tally->squares[i] / tally->runouts - mean * mean;
+    double interval = 1.96 * sqrt(variance / tally->runouts);
+    if (interval > widest)
+      widest = interval;
+  }
+  return widest;
+}
+
+void *run_sampling(void *arg) {
+  Worker *worker = arg;
+  const Problem *problem = worker->problem;
+  uint64_t state =
+      (problem->seed + worker->thread_index) * 0x9E3779B97F4A7C15ull;
+  if (state == 0)
+    state = 1;
+  const Combo *combos[MAX_PLAYERS];
+  Card deck[CARD_COUNT];
+  size_t missing = 5 - problem->board_count;
+  while (!atomic_load(&sampling_done)) {
+    Tally batch = {};
+    while (batch.runouts < SAMPLE_BATCH) {
+      // Draw combos until they do not clash, which keeps every valid set of
+      // combos equally likely
+      uint64_t used = problem->board_mask;
+      bool clash = false;
+      for (size_t i = 0; i < problem->players && !clash; i++) {
+        const Range *range = &problem->ranges[i];
+        combos[i] = &range->combos[next_sample_random(&state) % range->count];
+        clash = (combos[i]->mask & used) != 0;
+        used |= combos[i]->mask;
+      }
+      if (clash)
+        continue;
+      size_t deck_count = 0;
+      for (int i = 0; i < CARD_COUNT; i++) {
+        if (!(used & (1ull << i)))
+          deck[deck_count++] = index_card(i);
+      }
+      Card board[5];
+      memcpy(board, problem->board, sizeof(board));
+      for (size_t i = 0; i < missing; i++) {
+        size_t j = i + next_sample_random(&state) % (deck_count - i);
+        Card temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+        board[problem->board_count + i] = deck[i];
+      }
+      score_board(combos, problem->players, board, &batch);
+    }
+
+    pthread_mutex_lock(&tally_lock);
+    for (size_t i = 0; i < problem->players; i++) {
+      total.shares[i] += batch.shares[i];
+      total.squares[i] += batch.squares[i];
+    }
+    total.runouts += batch.runouts;
+    if (total.runouts >= problem->max_samples ||
+        (total.runouts >= MIN_SAMPLES &&
+         confidence_interval(&total, problem->players) <= problem->precision))
+      atomic_store(&sampling_done, true);
+    pthread_mutex_unlock(&tally_lock);
+  }
+  return NULL;
+}
+
+// Whether any set of combos fits together, so sampling can not spin forever
+bool has_valid_combos(const Problem *problem, size_t player, uint64_t used) {
+  if (player == problem->players)
+    return true;
+  const Range *range = &problem->ranges[player];
+  for (size_t i = 0; i < range->count; i++) {
+    if (!(range->combos[i].mask & used) &&
+        has_valid_combos(problem, player + 1, used | range->combos[i].mask))
+      return true;
+  }
+  return false;
+}
+
+double binomial(size_t n, size_t k) {
+  double result = 1.0;
+  for (size_t i = 0; i < k; i++)
+    result = result * (n - i) / (i + 1);
+  return result;
+}
+
+// Every card in the text, none of them already in `mask`
+bool parse_card_list(const char *text, const char *what, Card *cards,
+                     size_t max_cards, size_t *count, uint64_t *mask) {
+  *count = 0;
+  while (true) {
+    while (*text == ' ')
+      text++;
+    if (*text == '\0')
+      return true;
+    Card card;
+    size_t length = holdem_eval_parse_card(text, &card);
+    if (length == 0) {
+      fprintf(stderr, "holdem_equity: could not parse the %s at \"%s\"\n",
+              what, text);
+      return false;
+    }
+    if (*count == max_cards) {
+      fprintf(stderr, "holdem_equity: more than %zu cards in the %s\n",
+              max_cards, what);
+      return false;
+    }
+    if (*mask & card_mask(card)) {
+      fprintf(stderr, "holdem_equity: a card is used twice\n");
+      return false;
+    }
+    *mask |= card_mask(card);
+    cards[(*count)++] = card;
+    text += length;
+  }
+}
+
+double seconds_since(struct timespec start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+  static Problem problem = {.precision = 0.001,
+                            .max_samples = 100000000,
+                            .seed = 4653};
+  long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *board_text = "";
+  const char *dead_text = "";
+  const char *range_texts[MAX_PLAYERS];
+  bool force_exact = false;
+  bool force_sampling = false;
+  bool usage_error = false;
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-b") == 0 && has_value)
+      board_text = argv[++i];
+    else if (strcmp(argv[i], "-d") == 0 && has_value)
+      dead_text = argv[++i];
+    else if (strcmp(argv[i], "-t") == 0 && has_value)
+      thread_count = strtol(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-p") == 0 && has_value)
+      problem.precision = strtod(argv[++i], NULL) / 100.0;
+    else if (strcmp(argv[i], "-n") == 0 && has_value)
+      problem.max_samples = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-s") == 0 && has_value)
+      problem.seed = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-x") == 0)
+      force_exact = true;
+    else if (strcmp(argv[i], "-m") == 0)
+      force_sampling = true;
+    else if (argv[i][0] != '-' && problem.players < MAX_PLAYERS)
+      range_texts[problem.players++] = argv[i];
+    else
+      usage_error = true;
+  }
+  if (usage_error || problem.players < 2) {
+    fprintf(stderr, "usage: holdem_equity [-b board] [-d dead] [-t threads] "
+                    "[-p percent] [-n samples] [-s seed] [-x | -m] range "
+                    "range [range [range]]\n");
+    return 1;
+  }
+  if (thread_count < 1)
+    thread_count = 1;
+  if (thread_count > MAX_THREADS)
+    thread_count = MAX_THREADS;
+
+  uint64_t dead_mask = 0;
+  Card dead[CARD_COUNT];
+  size_t dead_count;
+  if (!parse_card_list(board_text, "board", problem.board, 5,
+                       &problem.board_count, &dead_mask) ||
+      !parse_card_list(dead_text, "dead cards", dead, CARD_COUNT, &dead_count,
+                       &dead_mask))
+    return 1;
+  problem.board_mask = dead_mask;
+  for (size_t i = 0; i < problem.players; i++) {
+    if (!parse_range(range_texts[i], &problem.ranges[i])) {
+      fprintf(stderr, "holdem_equity: could not parse range \"%s\"\n",
+              range_texts[i]);
+      return 1;
+    }
+    remove_dead_cards(&problem.ranges[i], dead_mask);
+  }
+  if (!has_valid_combos(&problem, 0, dead_mask)) {
+    fprintf(stderr, "holdem_equity: the ranges can not all be dealt\n");
+    return 1;
+  }
+
+  // Upper bound on the evaluations an exact answer needs
+  double combo_sets = 1.0;
+  for (size_t i = 0; i < problem.players; i++)
+    combo_sets *= problem.ranges[i].count;
+  size_t deck_left = CARD_COUNT - problem.players * 2 - problem.board_count -
+                     dead_count;
+  double work = combo_sets * binomial(deck_left, 5 - problem.board_count) *
+                problem.players;
+  bool exact = force_exact || (!force_sampling && work <= EXACT_LIMIT);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  static Worker workers[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  for (long i = 0; i < thread_count; i++) {
+    workers[i] = (Worker){&problem, i, thread_count, {}};
+    pthread_create(&threads[i], NULL, exact ? run_exact : run_sampling,
+                   &workers[i]);
+  }
+  for (long i = 0; i < thread_count; i++)
+    pthread_join(threads[i], NULL);
+  if (exact) {
+    for (long i = 0; i < thread_count; i++) {
+      for (size_t j = 0; j < problem.players; j++) {
+        total.shares[j] += workers[i].tally.shares[j];
+        total.squares[j] += workers[i].tally.squares[j];
+      }
+      total.runouts += workers[i].tally.runouts;
+    }
+  }
+  double seconds = seconds_since(start);
+
+  double interval = confidence_interval(&total, problem.players);
+  for (size_t i = 0; i < problem.players; i++) {
+    printf("Player %zu: %6.2f%%", i + 1,
+           100.0 * total.shares[i] / total.runouts);
+    if (!exact)
+      printf(" +/- %.2f%%", 100.0 * interval);
+    printf("  %s (%zu combos)\n", range_texts[i], problem.ranges[i].count);
+  }
+  printf("%s %llu runouts in %.3f s on %ld threads\n",
+         exact ? "Enumerated" : "Sampled", (unsigned long long)total.runouts,
+         seconds, thread_count);
+  return 0;
+}
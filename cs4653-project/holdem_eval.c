@@ -0,0 +1,232 @@
+#include "holdem_eval.h"
+#include "cards.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+uint32_t holdem_eval_abi_version(void) { return HOLDEM_EVAL_ABI_VERSION; }
+
+uint32_t holdem_eval_hand(const int16_t hand[2], const int16_t board[5]) {
+  Card total[7] = {hand[0],  hand[1],  board[0], board[1],
+                   board[2], board[3], board[4]};
+  return evaluate_cards(total, 7);
+}
+
+uint32_t holdem_eval_partial(const int16_t hand[2], const int16_t *board,
+                             size_t board_count) {
+  Card total[7] = {hand[0], hand[1]};
+  if (board_count > 5)
+    board_count = 5;
+  for (size_t i = 0; i < board_count; i++)
+    total[i + 2] = board[i];
+  return evaluate_cards(total, board_count + 2);
+}
+
+void holdem_eval_batch(const int16_t *hands, size_t count, uint32_t *values) {
+  for (size_t i = 0; i < count; i++) {
+    Card total[7];
+    for (int j = 0; j < 7; j++)
+      total[j] = hands[i * 7 + j];
+    values[i] = evaluate_cards(total, 7);
+  }
+}
+
+// xorshift64
+uint64_t next_runout_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Add one runout to the tally: every player with the best hand gets an even
+// share of the win
+void score_runout(const int16_t *hands, size_t players, Card board[5],
+                  double *wins) {
+  HandValue values[HOLDEM_EVAL_MAX_PLAYERS];
+  HandValue max_value = 0;
+  size_t winners = 0;
+  for (size_t i = 0; i < players; i++) {
+    Card total[7] = {hands[i * 2], hands[i * 2 + 1], board[0], board[1],
+                     board[2],     board[3],         board[4]};
+    values[i] = evaluate_cards(total, 7);
+    if (values[i] > max_value) {
+      max_value = values[i];
+      winners = 0;
+    }
+    if (values[i] == max_value)
+      winners += 1;
+  }
+  for (size_t i = 0; i < players; i++) {
+    if (values[i] == max_value)
+      wins[i] += 1.0 / winners;
+  }
+}
+
+int holdem_eval_equity(const int16_t *hands, size_t players,
+                       const int16_t *board, size_t board_count,
+                       uint64_t samples, uint64_t seed, double *equity) {
+  if (players < 2 || players > HOLDEM_EVAL_MAX_PLAYERS || board_count > 5)
+    return 0;
+  // Every card may only be used once
+  uint64_t used = 0;
+  for (size_t i = 0; i < players * 2 + board_count; i++) {
+    Card card = i < players * 2 ? hands[i] : board[i - players * 2];
+    int index = card_index(card);
+    if (index < 0 || (used & (1ull << index)))
+      return 0;
+    used |= 1ull << index;
+  }
+  Card deck[CARD_COUNT];
+  size_t deck_count = 0;
+  for (int i = 0; i < CARD_COUNT; i++) {
+    if (!(used & (1ull << i)))
+      deck[deck_count++] = index_card(i);
+  }
+
+  Card runout[5] = {};
+  for (size_t i = 0; i < board_count; i++)
+    runout[i] = board[i];
+  size_t missing = 5 - board_count;
+  double wins[HOLDEM_EVAL_MAX_PLAYERS] = {};
+  uint64_t runouts = 0;
+
+  if (samples == 0) {
+    // Walk the combinations of `missing` deck cards in order
+    size_t picks[5];
+    for (size_t i = 0; i < missing; i++)
+      picks[i] = i;
+    while (true) {
+      for (size_t i = 0; i < missing; i++)
+        runout[board_count + i] = deck[picks[i]];
+      score_runout(hands, players, runout, wins);
+      runouts += 1;
+      // Advance the rightmost pick that still has room
+      size_t i = missing;
+      while (i > 0 && picks[i - 1] == deck_count - missing + i - 1)
+        i--;
+      if (i == 0)
+        break;
+      picks[i - 1] += 1;
+      for (size_t j = i; j < missing; j++)
+        picks[j] = picks[j - 1] + 1;
+    }
+  } else {
+    uint64_t state = seed | 1;
+    for (uint64_t sample = 0; sample < samples; sample++) {
+      // Partial Fisher-Yates shuffle of the front of the deck
+      for (size_t i = 0; i < missing; i++) {
+        size_t j = i + next_runout_random(&state) % (deck_count - i);
+        Card temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+        runout[board_count + i] = deck[i];
+      }
+      score_runout(hands, players, runout, wins);
+      runouts += 1;
+    }
+  }
+
+  for (size_t i = 0; i < players; i++)
+    equity[i] = wins[i] / runouts;
+  return 1;
+}
+
+// Card notation lookup tables, 0 for characters that are not a face / suite
+static const int16_t FACE_CODES[256] = {
+    ['A'] = Ace,   ['a'] = Ace,   ['2'] = Two,   ['3'] = Three, ['4'] = Four,
+    ['5'] = Five,  ['6'] = Six,   ['7'] = Seven, ['8'] = Eight, ['9'] = Nine,
+    ['T'] = Ten,   ['t'] = Ten,   ['J'] = Jack,  ['j'] = Jack,  ['Q'] = Queen,
+    ['q'] = Queen, ['K'] = King,  ['k'] = King,
+};
+static const int16_t SUITE_CODES[256] = {
+    ['C'] = Club,    ['c'] = Club,    ['S'] = Spade, ['s'] = Spade,
+    ['D'] = Diamond, ['d'] = Diamond, ['H'] = Heart, ['h'] = Heart,
+};
+// Characters allowed between cards in a hand line
+static const bool CARD_SEPARATORS[256] = {
+    [' '] = true, ['\t'] = true, ['\r'] = true, ['|'] = true, [','] = true,
+};
+
+size_t holdem_eval_parse_card(const char *text, int16_t *card) {
+  int16_t face = FACE_CODES[(unsigned char)text[0]];
+  size_t length = 1;
+  // "10" is the only face longer than one character
+  if (face == 0 && text[0] == '1' && text[1] == '0') {
+    face = Ten;
+    length = 2;
+  }
+  if (face == 0)
+    return 0;
+  int16_t suite = SUITE_CODES[(unsigned char)text[length]];
+  if (suite == 0)
+    return 0;
+  *card = face | suite;
+  return length + 1;
+}
+
+size_t holdem_eval_parse_hand(const char *text, size_t length,
+                              int16_t cards[7]) {
+  size_t count = 0;
+  size_t i = 0;
+  while (i < length) {
+    unsigned char c = text[i];
+    if (CARD_SEPARATORS[c]) {
+      i++;
+      continue;
+    }
+    if (count == 7)
+      return 0;
+    int16_t face = FACE_CODES[c];
+    int16_t suite = 0;
+    if (i + 1 < length)
+      suite = SUITE_CODES[(unsigned char)text[i + 1]];
+    if ((face == 0) | (suite == 0)) {
+      // Slow path for "10"
+      if (i + 2 >= length || c != '1' ||
+          holdem_eval_parse_card(text + i, &cards[count]) != 3)
+        return 0;
+      count += 1;
+      i += 3;
+      continue;
+    }
+    cards[count++] = face | suite;
+    i += 2;
+  }
+  // A card can only be dealt once
+  uint64_t used = 0;
+  for (size_t j = 0; j < count; j++) {
+    uint64_t bit = 1ull << card_index(cards[j]);
+    if (used & bit)
+      return 0;
+    used |= bit;
+  }
+  return count >= 2 ? count : 0;
+}
+
+size_t holdem_eval_parse_cards(const char *text, int16_t *cards,
+                               size_t max_cards) {
+  size_t count = 0;
+  while (count < max_cards) {
+    while (*text == ' ')
+      text++;
+    size_t length = holdem_eval_parse_card(text, &cards[count]);
+    if (length == 0)
+      break;
+    text += length;
+    count += 1;
+  }
+  return count;
+}
+
+int holdem_eval_format_card(int16_t card, char text[3]) {
+  if (card_index(card) < 0)
+    return 0;
+  text[0] = "A23456789TJQK"[get_face(card) - Ace];
+  text[1] = "csdh"[(get_suite(card) >> 8) - 1];
+  text[2] = '\0';
+  return 1;
+}
+
+const char *holdem_eval_rank_name(uint32_t value) {
+  return hand_value_string(value);
+}
@@ -0,0 +1,84 @@
+#ifndef HOLDEM_EVAL_H
+#define HOLDEM_EVAL_H
+#include <stddef.h>
+#include <stdint.h>
+
+// Public C ABI of libholdem_eval, the game's hand evaluator as a shared
+// library. It does not depend on raylib.
+//
+// Cards use the game's encoding: face (1 = ace ... 13 = king) in the low byte
+// and suite (1 = club, 2 = spade, 3 = diamond, 4 = heart) in the high byte, 0
+// is no card. Hand values compare with plain integer comparison, higher is
+// better. Bits 20 and up hold the hand rank, 1 = high card to 10 = royal
+// flush, and below it up to 5 faces that break ties, 4 bits each from bit 16
+// down with aces as 14: the faces of the pairs, trips or quads first, then
+// the kickers.
+//
+// Functions that can fail return 1 on success and 0 on invalid input. The
+// ABI version only changes when existing functions change meaning or
+// signature, callers should check holdem_eval_abi_version() at startup.
+#define HOLDEM_EVAL_ABI_VERSION 1
+// Most hands holdem_eval_equity() can compare
+#define HOLDEM_EVAL_MAX_PLAYERS 10
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(HOLDEM_EVAL_BUILD)
+#define HOLDEM_EVAL_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define HOLDEM_EVAL_API __declspec(dllimport)
+#else
+#define HOLDEM_EVAL_API __attribute__((visibility("default")))
+#endif
+
+HOLDEM_EVAL_API uint32_t holdem_eval_abi_version(void);
+
+// Value of the best 5 card hand from 2 hole cards and a 5 card board
+HOLDEM_EVAL_API uint32_t holdem_eval_hand(const int16_t hand[2],
+                                          const int16_t board[5]);
+// Like holdem_eval_hand() with only the first `board_count` board cards
+// dealt, 0 to 5. Boards of fewer than 3 cards can only make pairs, trips and
+// quads
+HOLDEM_EVAL_API uint32_t holdem_eval_partial(const int16_t hand[2],
+                                             const int16_t *board,
+                                             size_t board_count);
+// Evaluate `count` hands stored as 7 cards each, hole cards first, into
+// `values`
+HOLDEM_EVAL_API void holdem_eval_batch(const int16_t *hands, size_t count,
+                                       uint32_t *values);
+
+// Chance of each of `players` hands (2 hole cards each, stored one after the
+// other) winning from a board with `board_count` cards already dealt, ties
+// split evenly. With `samples` 0 every possible runout is enumerated,
+// otherwise `samples` random runouts are drawn using `seed`
+HOLDEM_EVAL_API int holdem_eval_equity(const int16_t *hands, size_t players,
+                                       const int16_t *board,
+                                       size_t board_count, uint64_t samples,
+                                       uint64_t seed, double *equity);
+
+// Parse one card like "Ah", "td" or "10S" from the start of `text`. Returns
+// the number of characters read, or 0 if there is no valid card
+HOLDEM_EVAL_API size_t holdem_eval_parse_card(const char *text,
+                                              int16_t *card);
+// Parse up to `max_cards` cards, optionally separated by spaces. Returns the
+// number of cards read, stopping at the first text that is not a card
+HOLDEM_EVAL_API size_t holdem_eval_parse_cards(const char *text, int16_t *cards,
+                                               size_t max_cards);
+// Parse a hand line like "AhKd | 2c7s9dTcJh" of `length` characters, hole
+// cards first, then 0 to 5 board cards. Cards may be separated by spaces,
+// tabs, commas or a '|'. Returns the number of cards read into `cards`, or 0
+// if the line is not a valid hand or has the same card twice
+HOLDEM_EVAL_API size_t holdem_eval_parse_hand(const char *text, size_t length,
+                                              int16_t cards[7]);
+// Write a card as two characters like "Ah" plus a terminator. Returns 0 if
+// the card is not valid
+HOLDEM_EVAL_API int holdem_eval_format_card(int16_t card, char text[3]);
+// Name of the rank of a hand value, like "Full house"
+HOLDEM_EVAL_API const char *holdem_eval_rank_name(uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
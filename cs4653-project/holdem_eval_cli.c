@@ -0,0 +1,242 @@
+#include "holdem_eval.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Batch hand evaluator. Reads one hand per line, like "AhKd | 2c7s9dTcJh",
+// from a file (mmap'ed) or stdin and writes one hand value per line, 0 for
+// lines that are not a valid hand. Input is split into blocks; each block is
+// cut into one slice per thread at line boundaries, the threads parse,
+// evaluate and format their slice into their own buffer, and the buffers are
+// written out in order.
+//
+// usage: holdem_eval [-t threads] [-n] [file]
+//   -t  worker threads, defaults to the number of CPUs
+//   -n  append the rank name to each value
+
+// Input bytes handed to each thread per block
+#define SLICE_SIZE (4 << 20)
+#define MAX_THREADS 64
+// Longest output line: a value of up to 10 digits (8 for a valid hand), a
+// tab, the longest rank name ("Invalid hand value", 18) and a newline is 30
+#define MAX_OUTPUT_LINE 32
+
+typedef struct {
+  char *data;
+  size_t length;
+  size_t capacity;
+} OutputBuffer;
+
+typedef struct {
+  const char *start;
+  const char *end;
+  OutputBuffer output;
+} Slice;
+
+static bool write_names = false;
+
+void reserve_output(OutputBuffer *buffer, size_t length) {
+  if (buffer->length + length <= buffer->capacity)
+    return;
+  size_t capacity = buffer->capacity == 0 ? SLICE_SIZE : buffer->capacity * 2;
+  while (capacity < buffer->length + length)
+    capacity *= 2;
+  buffer->data = realloc(buffer->data, capacity);
+  if (buffer->data == NULL) {
+    fprintf(stderr, "holdem_eval: out of memory\n");
+    exit(1);
+  }
+  buffer->capacity = capacity;
+}
+
+void append_value(OutputBuffer *buffer, uint32_t value) {
+  reserve_output(buffer, MAX_OUTPUT_LINE);
+  char digits[10];
+  size_t count = 0;
+  uint32_t rest = value;
+  do {
+    digits[count++] = '0' + rest % 10;
+    rest /= 10;
+  } while (rest != 0);
+  char *out = buffer->data + buffer->length;
+  while (count > 0)
+    *out++ = digits[--count];
+  if (write_names && value != 0) {
+    const char *name = holdem_eval_rank_name(value);
+    *out++ = '\t';
+    while (*name != '\0')
+      *out++ = *name++;
+  }
+  *out++ = '\n';
+  buffer->length = out - buffer->data;
+}
+
+void *evaluate_slice(void *arg) {
+  Slice *slice = arg;
+  slice->output.length = 0;
+  const char *line = slice->start;
+  while (line < slice->end) {
+    const char *newline = memchr(line, '\n', slice->end - line);
+    const char *line_end = newline != NULL ? newline : slice->end;
+    int16_t cards[7];
+    size_t count = holdem_eval_parse_hand(line, line_end - line, cards);
+    uint32_t value = 0;
+    if (count != 0)
+      value = holdem_eval_partial(cards, cards + 2, count - 2);
+    append_value(&slice->output, value);
+    line = line_end + 1;
+  }
+  return NULL;
+}
+
+// Evaluate a block of whole lines across `thread_count` threads and write the
+// results to stdout in input order
+void process_block(const char *data, size_t length, Slice *slices,
+                   size_t thread_count) {
+  pthread_t threads[MAX_THREADS];
+  size_t slice_count = 0;
+  const char *start = data;
+  const char *end = data + length;
+  while (start < end && slice_count < thread_count) {
+    const char *slice_end = start + (end - start) / (thread_count - slice_count);
+    if (slice_end < end) {
+      // Extend the slice to the end of the line
+      const char *newline = memchr(slice_end, '\n', end - slice_end);
+      slice_end = newline != NULL ? newline + 1 : end;
+    }
+    slices[slice_count].start = start;
+    slices[slice_count].end = slice_end;
+    start = slice_end;
+    slice_count += 1;
+  }
+  for (size_t i = 1; i < slice_count; i++)
+    pthread_create(&threads[i], NULL, evaluate_slice, &slices[i]);
+  evaluate_slice(&slices[0]);
+  for (size_t i = 0; i < slice_count; i++) {
+    if (i > 0)
+      pthread_join(threads[i], NULL);
+    fwrite(slices[i].output.data, 1, slices[i].output.length, stdout);
+  }
+}
+
+// The whole file is mapped and walked in blocks
+bool process_file(const char *path, Slice *slices, size_t thread_count) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = info.st_size;
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+  char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  madvise(data, size, MADV_SEQUENTIAL);
+  size_t block_size = SLICE_SIZE * thread_count;
+  size_t offset = 0;
+  while (offset < size) {
+    size_t length = size - offset;
+    if (length > block_size) {
+      // Cut the block after the last whole line
+      const char *block_end = data + offset + block_size;
+      while (block_end > data + offset && block_end[-1] != '\n')
+        block_end--;
+      if (block_end > data + offset)
+        length = block_end - (data + offset);
+    }
+    process_block(data + offset, length, slices, thread_count);
+    offset += length;
+  }
+  munmap(data, size);
+  return true;
+}
+
+// stdin is read in blocks, a partial last line is carried over to the next
+bool process_stdin(Slice *slices, size_t thread_count) {
+  size_t block_size = SLICE_SIZE * thread_count;
+  char *buffer = malloc(block_size);
+  if (buffer == NULL)
+    return false;
+  size_t filled = 0;
+  while (true) {
+    ssize_t bytes = read(STDIN_FILENO, buffer + filled, block_size - filled);
+    if (bytes < 0) {
+      free(buffer);
+      return false;
+    }
+    filled += bytes;
+    bool at_end = bytes == 0;
+    if (filled < block_size && !at_end)
+      continue;
+    size_t length = filled;
+    if (!at_end) {
+      while (length > 0 && buffer[length - 1] != '\n')
+        length--;
+      // A single line longer than the block is evaluated on its own
+      if (length == 0)
+        length = filled;
+    }
+    if (length > 0)
+      process_block(buffer, length, slices, thread_count);
+    memmove(buffer, buffer + length, filled - length);
+    filled -= length;
+    if (at_end && filled == 0)
+      break;
+  }
+  free(buffer);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (holdem_eval_abi_version() != HOLDEM_EVAL_ABI_VERSION) {
+    fprintf(stderr, "holdem_eval: evaluator library ABI mismatch\n");
+    return 1;
+  }
+  long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      thread_count = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      write_names = true;
+    } else if (argv[i][0] != '-' && path == NULL) {
+      path = argv[i];
+    } else {
+      fprintf(stderr, "usage: holdem_eval [-t threads] [-n] [file]\n");
+      return 1;
+    }
+  }
+  if (thread_count < 1)
+    thread_count = 1;
+  if (thread_count > MAX_THREADS)
+    thread_count = MAX_THREADS;
+
+  static char stdout_buffer[1 << 20];
+  setvbuf(stdout, stdout_buffer, _IOFBF, sizeof(stdout_buffer));
+  Slice slices[MAX_THREADS] = {};
+  bool ok = path != NULL ? process_file(path, slices, thread_count)
+                         : process_stdin(slices, thread_count);
+  if (!ok) {
+    fprintf(stderr, "holdem_eval: could not read %s\n",
+            path != NULL ? path : "stdin");
+    return 1;
+  }
+  fflush(stdout);
+  for (long i = 0; i < thread_count; i++)
+    free(slices[i].output.data);
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "integrity.h"
+#include "debuggerFunctions.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct {
+  int32_t *values;
+  size_t count;
+  // Checksum of the values as last written through integrity_write
+  uint32_t expected;
+  bool has_total;
+  int32_t total;
+} Region;
+
+static Region regions[INTEGRITY_REGION_COUNT] = {};
+static atomic_bool integrity_violated = false;
+
+// Check schedule
+static uint32_t check_interval_ms = 500;
+static uint32_t check_jitter_ms = 250;
+static double next_check = 0;
+// The monitor has its own generator so it does not disturb the game's rand()
+static uint32_t jitter_state = 0;
+
+// Each slot gets a different odd weight, so swapping values between slots
+// changes the checksum
+uint32_t slot_weight(size_t index) {
+  return (uint32_t)(index * 2 + 1) * 0x9E3779B1u;
+}
+
+uint32_t checksum_region(const Region *region) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < region->count; i++)
+    sum += (uint32_t)region->values[i] * slot_weight(i);
+  return sum;
+}
+
+void register_integrity_region(IntegrityRegion region, int32_t *values,
+                               size_t count) {
+  regions[region].values = values;
+  regions[region].count = count;
+  regions[region].expected = checksum_region(&regions[region]);
+}
+
+void set_integrity_total(IntegrityRegion region, int32_t total) {
+  regions[region].has_total = true;
+  regions[region].total = total;
+}
+
+void integrity_write(IntegrityRegion region, size_t index, int32_t value) {
+  Region *r = &regions[region];
+  r->expected += ((uint32_t)value - (uint32_t)r->values[index]) *
+                 slot_weight(index);
+  r->values[index] = value;
+}
+
+void configure_integrity_monitor(uint32_t interval_ms, uint32_t jitter_ms) {
+  check_interval_ms = interval_ms;
+  check_jitter_ms = jitter_ms < interval_ms ? jitter_ms : interval_ms;
+  next_check = 0;
+}
+
+// xorshift32
+uint32_t next_jitter() {
+  if (jitter_state == 0)
+    jitter_state = (uint32_t)time(NULL) | 1;
+  jitter_state ^= jitter_state << 13;
+  jitter_state ^= jitter_state >> 17;
+  jitter_state ^= jitter_state << 5;
+  return jitter_state;
+}
+
+void schedule_next_check(double now) {
+  int64_t delay = check_interval_ms;
+  if (check_jitter_ms > 0)
+    delay += (int64_t)(next_jitter() % (2 * check_jitter_ms + 1)) -
+             check_jitter_ms;
+  next_check = now + delay / 1000.0;
+}
+
+void check_integrity() {
+  execute_anti_disassembly();
+  for (int i = 0; i < INTEGRITY_REGION_COUNT; i++) {
+    Region *region = &regions[i];
+    if (region->values == NULL)
+      continue;
+    if (checksum_region(region) != region->expected) {
+      printf("Game state was modified externally\n");
+      report_integrity_violation();
+    }
+    if (region->has_total) {
+      int32_t total = 0;
+      for (size_t j = 0; j < region->count; j++)
+        total += region->values[j];
+      // Check for invalid money amount
+      if (total != region->total) {
+        printf("Invalid total in game state\n");
+        report_integrity_violation();
+      }
+    }
+  }
+}
+
+void run_integrity_monitor(double now) {
+  if (now < next_check)
+    return;
+  if (next_check != 0)
+    check_integrity();
+  schedule_next_check(now);
+}
+
+void report_integrity_violation() {
+  atomic_store_explicit(&integrity_violated, true, memory_order_release);
+}
+
+bool is_integrity_violated() {
+  return atomic_load_explicit(&integrity_violated, memory_order_acquire);
+}
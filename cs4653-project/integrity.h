@@ -0,0 +1,33 @@
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Integrity monitor. Game state arrays are registered as regions, and every
+// legitimate write goes through integrity_write() which keeps an incremental
+// checksum of the region up to date. On a jittered schedule the monitor
+// recomputes the checksums and checks invariants; any mismatch means the
+// memory was changed from outside the game. Detections from any check set a
+// single flag that the game loop reads once per frame.
+typedef enum {
+  MoneyRegion,
+  BetsRegion,
+  INTEGRITY_REGION_COUNT,
+} IntegrityRegion;
+
+void register_integrity_region(IntegrityRegion region, int32_t *values,
+                               size_t count);
+// The values of `region` must always add up to `total`
+void set_integrity_total(IntegrityRegion region, int32_t total);
+// Write `value` into a registered region and update its checksum
+void integrity_write(IntegrityRegion region, size_t index, int32_t value);
+// Checks run every `interval_ms` plus or minus up to `jitter_ms`
+void configure_integrity_monitor(uint32_t interval_ms, uint32_t jitter_ms);
+// Run the checks if they are due, `now` is in seconds
+void run_integrity_monitor(double now);
+// Safe to call from any thread
+void report_integrity_violation();
+bool is_integrity_violated();
+
+#endif
@@ -0,0 +1,340 @@
+#include "journal.h"
+#include "history.h"
+#include "metrics.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Entries waiting for a commit. The game only waits on the committer if a
+// whole buffer fills within one commit interval
+#define JOURNAL_BUFFER_SIZE 65536
+// Longest entry: the kind byte and a varint
+#define JOURNAL_ENTRY_MAX 11
+
+typedef struct {
+  JournalEntryKind kind;
+  // Phase of a phase event, otherwise the seat
+  size_t value;
+  BotAction action;
+} JournalEntry;
+
+size_t encode_journal_entry(const JournalEntry *entry, uint8_t *out) {
+  size_t length = 1;
+  out[0] = entry->kind;
+  if (entry->kind == JournalPhase || entry->kind == JournalTurn)
+    out[0] |= entry->value << 2;
+  if (entry->kind == JournalInput) {
+    out[0] |= entry->value << 2 | entry->action.type << 4;
+    if (entry->action.type == BotBet)
+      length += put_varint(out + 1, zigzag(entry->action.amount));
+  }
+  return length;
+}
+
+// Returns the bytes read, or 0 if the entry is cut short or malformed
+size_t decode_journal_entry(const uint8_t *data, size_t size,
+                            JournalEntry *entry) {
+  if (size == 0)
+    return 0;
+  memset(entry, 0, sizeof(*entry));
+  entry->kind = data[0] & 3;
+  size_t position = 1;
+  switch (entry->kind) {
+  case JournalPhase:
+  case JournalTurn:
+    entry->value = data[0] >> 2;
+    return position;
+  case JournalInput: {
+    entry->value = data[0] >> 2 & 3;
+    entry->action.type = data[0] >> 4;
+    if (entry->action.type > BotBet)
+      return 0;
+    uint64_t amount;
+    if (entry->action.type == BotBet) {
+      if (!get_varint(data, size, &position, &amount))
+        return 0;
+      entry->action.amount = unzigzag(amount);
+    }
+    return position;
+  }
+  default:
+    return 0;
+  }
+}
+
+#ifndef _WIN32
+static int journal_fd = -1;
+static atomic_bool journal_running = false;
+static atomic_bool committer_stop = false;
+static pthread_t committer_thread;
+
+// Entries are appended to the active buffer while the committer writes the
+// other one
+static pthread_mutex_t buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t buffer_committed = PTHREAD_COND_INITIALIZER;
+static uint8_t buffers[2][JOURNAL_BUFFER_SIZE];
+static size_t buffer_used[2] = {};
+static size_t active_buffer = 0;
+// A new game for the committer to start the file over with
+static bool restart_pending = false;
+static uint32_t restart_seed = 0;
+
+// Entries to replay, the journal as it was read on start
+static uint8_t *replay_data = NULL;
+static size_t replay_size = 0;
+static size_t replay_position = 0;
+
+// Cut the file down to a header for a game played from `seed`. Writes are
+// O_APPEND, so the header lands at the start
+bool write_journal_header(uint32_t seed) {
+  JournalHeader header = {
+      .magic = JOURNAL_MAGIC, .version = JOURNAL_FORMAT_VERSION, .seed = seed};
+  return ftruncate(journal_fd, 0) == 0 &&
+         write(journal_fd, &header, sizeof(header)) == sizeof(header);
+}
+
+void *run_journal_committer(void *arg) {
+  for (;;) {
+    bool stopping = atomic_load(&committer_stop);
+    if (!stopping)
+      usleep(JOURNAL_COMMIT_MICROSECONDS);
+    pthread_mutex_lock(&buffer_mutex);
+    size_t buffer = active_buffer;
+    size_t used = buffer_used[buffer];
+    if (used > 0)
+      active_buffer ^= 1;
+    // Everything buffered before the new game was dropped, and what was
+    // written before it is cut off here
+    bool restart = restart_pending;
+    uint32_t seed = restart_seed;
+    restart_pending = false;
+    pthread_mutex_unlock(&buffer_mutex);
+    if (used == 0 && !restart) {
+      if (stopping)
+        return NULL;
+      continue;
+    }
+    if (restart && !write_journal_header(seed))
+      perror("Could not start the journal over");
+    // One write and one sync for every entry of the interval
+    size_t written = 0;
+    while (written < used) {
+      ssize_t result =
+          write(journal_fd, buffers[buffer] + written, used - written);
+      if (result < 0) {
+        perror("Could not write journal");
+        break;
+      }
+      written += result;
+    }
+    fsync(journal_fd);
+    metric_add(MetricJournalCommits, 1);
+    if (used == 0)
+      continue;
+    pthread_mutex_lock(&buffer_mutex);
+    buffer_used[buffer] = 0;
+    pthread_cond_broadcast(&buffer_committed);
+    pthread_mutex_unlock(&buffer_mutex);
+  }
+}
+
+void append_journal_entry(const JournalEntry *entry) {
+  if (!atomic_load(&journal_running) || replay_data != NULL)
+    return;
+  uint8_t encoded[JOURNAL_ENTRY_MAX];
+  size_t length = encode_journal_entry(entry, encoded);
+  pthread_mutex_lock(&buffer_mutex);
+  while (buffer_used[active_buffer] + length > JOURNAL_BUFFER_SIZE)
+    pthread_cond_wait(&buffer_committed, &buffer_mutex);
+  memcpy(buffers[active_buffer] + buffer_used[active_buffer], encoded, length);
+  buffer_used[active_buffer] += length;
+  pthread_mutex_unlock(&buffer_mutex);
+  metric_add(MetricJournalEntries, 1);
+}
+
+// Read the whole journal and find where its last whole entry ends
+bool read_journal(uint32_t *seed) {
+  struct stat info;
+  if (fstat(journal_fd, &info) != 0)
+    return false;
+  if (info.st_size == 0)
+    return write_journal_header(*seed);
+  JournalHeader header;
+  if (info.st_size < (off_t)sizeof(header) ||
+      pread(journal_fd, &header, sizeof(header), 0) != sizeof(header) ||
+      header.magic != JOURNAL_MAGIC ||
+      header.version != JOURNAL_FORMAT_VERSION)
+    return false;
+  *seed = header.seed;
+  size_t size = info.st_size - sizeof(header);
+  if (size == 0)
+    return true;
+  uint8_t *data = malloc(size);
+  if (pread(journal_fd, data, size, sizeof(header)) != (ssize_t)size) {
+    free(data);
+    return false;
+  }
+  size_t position = 0;
+  JournalEntry entry;
+  size_t length;
+  while ((length = decode_journal_entry(data + position, size - position,
+                                        &entry)) > 0)
+    position += length;
+  if (position < size &&
+      ftruncate(journal_fd, sizeof(header) + position) != 0) {
+    free(data);
+    return false;
+  }
+  if (position == 0) {
+    free(data);
+    return true;
+  }
+  replay_data = data;
+  replay_size = position;
+  replay_position = 0;
+  return true;
+}
+
+bool start_journal(const char *path, uint32_t *seed) {
+  if (atomic_load(&journal_running))
+    return false;
+  journal_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (journal_fd < 0)
+    return false;
+  if (!read_journal(seed)) {
+    close(journal_fd);
+    journal_fd = -1;
+    return false;
+  }
+  buffer_used[0] = buffer_used[1] = 0;
+  restart_pending = false;
+  atomic_store(&committer_stop, false);
+  if (pthread_create(&committer_thread, NULL, run_journal_committer, NULL) !=
+      0) {
+    close(journal_fd);
+    journal_fd = -1;
+    free(replay_data);
+    replay_data = NULL;
+    return false;
+  }
+  atomic_store(&journal_running, true);
+  return true;
+}
+
+void stop_journal() {
+  if (!atomic_load(&journal_running))
+    return;
+  stop_journal_recovery();
+  atomic_store(&journal_running, false);
+  atomic_store(&committer_stop, true);
+  pthread_join(committer_thread, NULL);
+  close(journal_fd);
+  journal_fd = -1;
+}
+
+bool is_journal_enabled() { return atomic_load(&journal_running); }
+
+bool is_journal_recovering() { return replay_data != NULL; }
+
+void stop_journal_recovery() {
+  if (replay_data == NULL)
+    return;
+  // O_APPEND writes follow on from the new end
+  if (replay_position < replay_size &&
+      ftruncate(journal_fd, sizeof(JournalHeader) + replay_position) != 0)
+    perror("Could not cut the journal");
+  free(replay_data);
+  replay_data = NULL;
+}
+
+// Take the next entry to replay, ending the replay after the last one
+void next_replay_entry(JournalEntry *entry) {
+  replay_position += decode_journal_entry(replay_data + replay_position,
+                                          replay_size - replay_position, entry);
+  if (replay_position == replay_size)
+    stop_journal_recovery();
+}
+
+// The next entry differs from what the table did. Everything from there on
+// is dropped
+void report_journal_mismatch(const char *what) {
+  printf("Journal replay out of step at byte %zu: expected %s\n",
+         sizeof(JournalHeader) + replay_position, what);
+  stop_journal_recovery();
+}
+
+bool journal_event(JournalEntryKind kind, size_t value) {
+  if (replay_data == NULL) {
+    append_journal_entry(&(JournalEntry){.kind = kind, .value = value});
+    return true;
+  }
+  JournalEntry entry;
+  size_t position = replay_position;
+  decode_journal_entry(replay_data + position, replay_size - position, &entry);
+  if (entry.kind != kind || entry.value != value) {
+    report_journal_mismatch(kind == JournalPhase ? "a phase" : "a turn");
+    return false;
+  }
+  next_replay_entry(&entry);
+  return true;
+}
+
+void journal_input(size_t seat, BotAction action) {
+  append_journal_entry(
+      &(JournalEntry){.kind = JournalInput, .value = seat, .action = action});
+}
+
+void journal_new_game(uint32_t seed) {
+  if (!atomic_load(&journal_running) || replay_data != NULL)
+    return;
+  pthread_mutex_lock(&buffer_mutex);
+  buffer_used[active_buffer] = 0;
+  restart_pending = true;
+  restart_seed = seed;
+  pthread_cond_broadcast(&buffer_committed);
+  pthread_mutex_unlock(&buffer_mutex);
+}
+
+bool read_journal_input(size_t seat, BotAction *action) {
+  if (replay_data == NULL)
+    return false;
+  JournalEntry entry;
+  decode_journal_entry(replay_data + replay_position,
+                       replay_size - replay_position, &entry);
+  if (entry.kind != JournalInput || entry.value != seat) {
+    report_journal_mismatch("an action");
+    return false;
+  }
+  *action = entry.action;
+  next_replay_entry(&entry);
+  return true;
+}
+#else
+// No committer thread on Windows, the table is not journaled
+bool start_journal(const char *path, uint32_t *seed) { return false; }
+
+void stop_journal() {}
+
+bool is_journal_enabled() { return false; }
+
+bool is_journal_recovering() { return false; }
+
+void stop_journal_recovery() {}
+
+bool journal_event(JournalEntryKind kind, size_t value) { return true; }
+
+void journal_input(size_t seat, BotAction action) {}
+
+void journal_new_game(uint32_t seed) {}
+
+bool read_journal_input(size_t seat, BotAction *action) { return false; }
+#endif
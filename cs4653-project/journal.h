@@ -0,0 +1,73 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include "bot.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Event journal. The table only changes through the game's event queue, and
+// the only randomness is the rand() shuffle, so the seed, every event the
+// game loop finishes and every action taken by a bot or the player are
+// enough to play the table again to exactly the same state. The journal is
+// append only; entries collect in memory and a committer thread writes and
+// syncs them as one group every JOURNAL_COMMIT_MICROSECONDS.
+//
+// Each game is played from its own seed, and a new game starts the journal
+// over with that seed in the header. The journal holds at most one game, so
+// recovery never replays more than that.
+//
+// A journal that already has entries is replayed on start: the game loop
+// runs its events with the recorded actions in place of the bots and the
+// player, checking each finished event against the journal, and carries on
+// appending once the entries run out. A torn entry at the end, from a crash
+// in the middle of a write, is cut off.
+//
+// File layout: a JournalHeader, then entries. An entry is one byte, the kind
+// in the low 2 bits and the phase, or the seat and action type, above them.
+// A bet is followed by its amount as a zigzag varint.
+
+#define JOURNAL_MAGIC 0x524a4848 // "HHJR"
+#define JOURNAL_FORMAT_VERSION 2
+#define JOURNAL_COMMIT_MICROSECONDS 2000
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  // Seed of rand() for the game in the journal
+  uint32_t seed;
+  uint32_t reserved;
+} JournalHeader;
+
+typedef enum {
+  JournalPhase,
+  JournalTurn,
+  // A bot or the player acting, before its turn finishes
+  JournalInput,
+} JournalEntryKind;
+
+// Open the journal at `path`, creating it with `seed` if it is new, or
+// setting `seed` to the journal's own if it has entries to replay. Returns
+// false if it can not be opened or is not a journal
+bool start_journal(const char *path, uint32_t *seed);
+// Commit everything written and close the journal
+void stop_journal();
+bool is_journal_enabled();
+// Whether the journal still has entries to replay
+bool is_journal_recovering();
+// Stop replaying and cut the journal where the replay got to, so new entries
+// follow on from the table as it is
+void stop_journal_recovery();
+
+// Append a finished phase or turn event, or when replaying, check the next
+// entry is the same event. Returns false if it is not, which stops the replay
+bool journal_event(JournalEntryKind kind, size_t value);
+// Append an action. Nothing is appended while replaying
+void journal_input(size_t seat, BotAction action);
+// Start the journal over for a new game played from `seed`. Ignored while
+// replaying
+void journal_new_game(uint32_t seed);
+// Replaying: the next action of `seat`. Returns false, stopping the replay,
+// if the next entry is something else
+bool read_journal_input(size_t seat, BotAction *action);
+
+#endif
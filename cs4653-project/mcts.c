@@ -0,0 +1,443 @@
+#include "mcts.h"
+#include "metrics.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define MCTS_NODES (1 << 16)
+// Twice the nodes, so probes stay short
+#define MCTS_TABLE_SIZE (MCTS_NODES * 2)
+#define MCTS_PROBE_LIMIT 32
+#define MAX_SEARCH_THREADS 8
+#define DEFAULT_SEARCH_THREADS 2
+// Longest line from any state to the end of the hand
+#define MAX_DEPTH 64
+// UCB exploration constant, for rewards between 0 and 1
+#define EXPLORATION 1.0
+// Iterations between checks of the clock
+#define ITERATION_BATCH 8
+// Chips are hashed in bet steps, amounts further apart than this share keys
+#define BET_STEP 10
+#define CHIP_KEYS 512
+
+typedef struct {
+  uint64_t hash;
+  // Includes the threads still on their way down through the node
+  _Atomic uint32_t visits;
+  // Sum of each seat's reward over the finished visits
+  _Atomic float rewards[SEAT_COUNT];
+} MctsNode;
+
+// A state in the search: the betting and the hash of it
+typedef struct {
+  HandState hand;
+  bool finished;
+  uint64_t hash;
+} SearchState;
+
+// What a search starts from
+typedef struct {
+  SearchState state;
+  Card hole[2];
+  Card board[5];
+  size_t board_count;
+  size_t root_seat;
+  // Money each seat had at the root, and all money on the table
+  int32_t start_money[SEAT_COUNT];
+  float scale;
+  uint64_t deadline;
+  uint64_t seed;
+} SearchRoot;
+
+static MctsNode nodes[MCTS_NODES];
+static _Atomic uint32_t node_count = 0;
+// Node index plus one, 0 for an empty slot
+static _Atomic uint32_t node_table[MCTS_TABLE_SIZE];
+static atomic_bool tree_busy = false;
+static size_t search_threads = DEFAULT_SEARCH_THREADS;
+
+// Zobrist keys
+static bool keys_ready = false;
+static uint64_t folded_keys[SEAT_COUNT];
+static uint64_t money_keys[SEAT_COUNT][CHIP_KEYS];
+static uint64_t bet_keys[SEAT_COUNT][CHIP_KEYS];
+static uint64_t street_keys[STREET_COUNT];
+static uint64_t seat_keys[SEAT_COUNT];
+static uint64_t bet_made_key;
+
+void set_mcts_threads(size_t count) {
+  if (count < 1)
+    count = 1;
+  search_threads = count > MAX_SEARCH_THREADS ? MAX_SEARCH_THREADS : count;
+}
+
+// splitmix64, for the keys
+uint64_t next_key(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// xorshift64
+uint64_t next_search_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+void init_zobrist_keys() {
+  uint64_t state = 4653;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    folded_keys[i] = next_key(&state);
+    seat_keys[i] = next_key(&state);
+    for (size_t j = 0; j < CHIP_KEYS; j++) {
+      money_keys[i][j] = next_key(&state);
+      bet_keys[i][j] = next_key(&state);
+    }
+  }
+  for (size_t i = 0; i < STREET_COUNT; i++)
+    street_keys[i] = next_key(&state);
+  bet_made_key = next_key(&state);
+  keys_ready = true;
+}
+
+size_t chip_key(int32_t chips) { return chips / BET_STEP % CHIP_KEYS; }
+
+// Part of the hash that belongs to one seat's money, bet and fold
+uint64_t seat_hash(const HandState *hand, size_t seat) {
+  uint64_t hash = money_keys[seat][chip_key(hand->table.money[seat])] ^
+                  bet_keys[seat][chip_key(hand->table.current_bets[seat])];
+  return hand->table.folded[seat] ? hash ^ folded_keys[seat] : hash;
+}
+
+// Part of the hash for whose turn it is
+uint64_t turn_hash(const HandState *hand) {
+  uint64_t hash = street_keys[hand->street] ^ seat_keys[hand->seat];
+  return hand->bet_made ? hash ^ bet_made_key : hash;
+}
+
+uint64_t full_hash(const HandState *hand) {
+  uint64_t hash = turn_hash(hand);
+  for (size_t i = 0; i < SEAT_COUNT; i++)
+    hash ^= seat_hash(hand, i);
+  return hash;
+}
+
+// Take an action and update the hash with only what it changed
+void step(SearchState *state, CfrAction action) {
+  HandState *hand = &state->hand;
+  size_t seat = hand->seat;
+  size_t street = hand->street;
+  state->hash ^= seat_hash(hand, seat) ^ turn_hash(hand);
+  apply_cfr_action(hand, action);
+  state->hash ^= seat_hash(hand, seat);
+  int32_t bets[SEAT_COUNT];
+  memcpy(bets, hand->table.current_bets, sizeof(bets));
+  state->finished = !advance_hand(hand);
+  if (hand->street != street) {
+    // A new street clears every bet
+    for (size_t i = 0; i < SEAT_COUNT; i++)
+      state->hash ^= bet_keys[i][chip_key(bets[i])] ^ bet_keys[i][0];
+  }
+  if (!state->finished)
+    state->hash ^= turn_hash(hand);
+}
+
+bool is_action_legal(const HandState *hand, CfrAction action) {
+  if (resolve_call(&hand->table, hand->seat) != 0)
+    return action == CfrFold || action == CfrCall;
+  if (hand->bet_made)
+    return action == CfrCall;
+  return action != CfrFold;
+}
+
+// Node for a hash, created if `create` is set. NULL if it does not exist or
+// the arena is full. Sets `created` if this call made the node
+MctsNode *find_node(uint64_t hash, bool create, bool *created) {
+  size_t slot = (hash >> 16) % MCTS_TABLE_SIZE;
+  for (size_t i = 0; i < MCTS_PROBE_LIMIT; i++) {
+    _Atomic uint32_t *entry = &node_table[(slot + i) % MCTS_TABLE_SIZE];
+    uint32_t index = atomic_load_explicit(entry, memory_order_acquire);
+    while (index == 0) {
+      if (!create)
+        return NULL;
+      uint32_t fresh = atomic_fetch_add(&node_count, 1);
+      if (fresh >= MCTS_NODES)
+        return NULL;
+      MctsNode *node = &nodes[fresh];
+      node->hash = hash;
+      atomic_store_explicit(&node->visits, 0, memory_order_relaxed);
+      for (size_t j = 0; j < SEAT_COUNT; j++)
+        atomic_store_explicit(&node->rewards[j], 0.0, memory_order_relaxed);
+      // Publish the node, unless another thread took the slot first. Then
+      // the fresh node is wasted and the slot is checked again
+      if (atomic_compare_exchange_strong_explicit(entry, &index, fresh + 1,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+        *created = true;
+        return node;
+      }
+    }
+    if (nodes[index - 1].hash == hash)
+      return &nodes[index - 1];
+  }
+  return NULL;
+}
+
+void add_reward(_Atomic float *target, float amount) {
+  float old = atomic_load_explicit(target, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(
+      target, &old, old + amount, memory_order_relaxed, memory_order_relaxed))
+    ;
+}
+
+// Deal the cards the root seat can not see, and value every seat's hand
+void determinize(const SearchRoot *root, uint64_t *random,
+                 HandValue values[SEAT_COUNT]) {
+  uint64_t used = (1ull << card_index(root->hole[0])) |
+                  (1ull << card_index(root->hole[1]));
+  for (size_t i = 0; i < root->board_count; i++)
+    used |= 1ull << card_index(root->board[i]);
+  Card deck[CARD_COUNT];
+  size_t deck_count = 0;
+  for (int i = 0; i < CARD_COUNT; i++) {
+    if (!(used & (1ull << i)))
+      deck[deck_count++] = index_card(i);
+  }
+  size_t missing = 5 - root->board_count;
+  size_t dealt = missing + (SEAT_COUNT - 1) * 2;
+  for (size_t i = 0; i < dealt; i++) {
+    size_t j = i + next_search_random(random) % (deck_count - i);
+    Card temp = deck[i];
+    deck[i] = deck[j];
+    deck[j] = temp;
+  }
+  Card cards[7];
+  for (size_t i = 0; i < 5; i++)
+    cards[i + 2] = i < root->board_count ? root->board[i]
+                                         : deck[i - root->board_count];
+  const Card *opponent_cards = deck + missing;
+  for (size_t seat = 0; seat < SEAT_COUNT; seat++) {
+    if (seat == root->root_seat) {
+      cards[0] = root->hole[0];
+      cards[1] = root->hole[1];
+    } else {
+      cards[0] = *opponent_cards++;
+      cards[1] = *opponent_cards++;
+    }
+    values[seat] = evaluate_cards(cards, 7);
+  }
+}
+
+// Rewards at the end of the hand, between 0 and 1: losing everything on the
+// table is 0, winning it is 1
+void score_hand(const SearchRoot *root, const HandState *hand,
+                const HandValue values[SEAT_COUNT],
+                float rewards[SEAT_COUNT]) {
+  const TableState *table = &hand->table;
+  HandValue best = 0;
+  size_t winners = 0;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    if (table->folded[i])
+      continue;
+    if (values[i] > best) {
+      best = values[i];
+      winners = 0;
+    }
+    winners += values[i] == best;
+  }
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    float result = table->money[i] - root->start_money[i];
+    if (!table->folded[i] && values[i] == best)
+      result += (float)table->money[POT] / winners;
+    rewards[i] = (result + root->scale) / (2 * root->scale);
+  }
+}
+
+// One playout: down the tree by UCB, expand one node, check the hand down and
+// back the rewards up the path
+void run_iteration(const SearchRoot *root, MctsNode *root_node,
+                   uint64_t *random) {
+  HandValue values[SEAT_COUNT];
+  determinize(root, random, values);
+  SearchState state = root->state;
+  MctsNode *path[MAX_DEPTH];
+  size_t depth = 0;
+  path[depth++] = root_node;
+  atomic_fetch_add(&root_node->visits, 1);
+
+  bool expanded = false;
+  while (!state.finished && !expanded && depth < MAX_DEPTH) {
+    MctsNode *parent = path[depth - 1];
+    float log_visits = logf(atomic_load(&parent->visits) + 1);
+    size_t seat = state.hand.seat;
+    SearchState best_state;
+    float best_score = -INFINITY;
+    for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+      if (!is_action_legal(&state.hand, i))
+        continue;
+      SearchState child = state;
+      step(&child, i);
+      bool created = false;
+      MctsNode *node = find_node(child.hash, false, &created);
+      uint32_t visits = node == NULL ? 0 : atomic_load(&node->visits);
+      // Unvisited actions first, then by UCB. Visits still in flight count
+      // as losses
+      float score = INFINITY;
+      if (visits > 0)
+        score = atomic_load(&node->rewards[seat]) / visits +
+                EXPLORATION * sqrtf(log_visits / visits);
+      if (score > best_score) {
+        best_score = score;
+        best_state = child;
+      }
+    }
+    state = best_state;
+    MctsNode *node = find_node(state.hash, true, &expanded);
+    // With the arena full, play out from here without growing the tree
+    if (node == NULL)
+      break;
+    atomic_fetch_add(&node->visits, 1);
+    path[depth++] = node;
+  }
+
+  // Check the hand down to the showdown
+  while (!state.finished)
+    step(&state, CfrCall);
+  float rewards[SEAT_COUNT];
+  score_hand(root, &state.hand, values, rewards);
+  for (size_t i = 0; i < depth; i++) {
+    for (size_t j = 0; j < SEAT_COUNT; j++)
+      add_reward(&path[i]->rewards[j], rewards[j]);
+  }
+}
+
+typedef struct {
+  const SearchRoot *root;
+  MctsNode *root_node;
+  uint64_t seed;
+  uint64_t iterations;
+} SearchWorker;
+
+void *run_search(void *arg) {
+  SearchWorker *worker = arg;
+  uint64_t random = worker->seed | 1;
+  while (metrics_now() < worker->root->deadline &&
+         atomic_load_explicit(&node_count, memory_order_relaxed) <
+             MCTS_NODES) {
+    for (size_t i = 0; i < ITERATION_BATCH; i++)
+      run_iteration(worker->root, worker->root_node, &random);
+    worker->iterations += ITERATION_BATCH;
+  }
+  return NULL;
+}
+
+SearchRoot make_root(const BotView *view, uint64_t deadline) {
+  SearchRoot root = {};
+  HandState *hand = &root.state.hand;
+  hand->table = view->table;
+  hand->street = view->board_count == 0 ? 0 : view->board_count - 2;
+  hand->seat = view->seat;
+  hand->bet_made = get_max_bet(&view->table) > 0;
+  root.state.hash = full_hash(hand);
+  root.hole[0] = view->hole[0];
+  root.hole[1] = view->hole[1];
+  memcpy(root.board, view->board, sizeof(root.board));
+  root.board_count = view->board_count;
+  root.root_seat = view->seat;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    root.start_money[i] = view->table.money[i];
+    root.scale += view->table.money[i];
+  }
+  root.scale += view->table.money[POT];
+  if (root.scale <= 0)
+    root.scale = 1;
+  root.deadline = deadline;
+  // Seeded by the spot, so the same spot searches the same deals
+  root.seed = root.state.hash;
+  for (size_t i = 0; i < 2 + view->board_count; i++) {
+    Card card = i < 2 ? view->hole[i] : view->board[i - 2];
+    root.seed = (root.seed ^ card) * 0x100000001B3ull;
+  }
+  return root;
+}
+
+bool search_mcts(const BotView *view, uint64_t deadline, CfrAction *action) {
+  if (atomic_exchange(&tree_busy, true))
+    return false;
+  if (!keys_ready)
+    init_zobrist_keys();
+  SearchRoot root = make_root(view, deadline);
+  // Nothing to search with only one action
+  size_t legal = 0;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    if (is_action_legal(&root.state.hand, i)) {
+      legal += 1;
+      *action = i;
+    }
+  }
+  if (legal == 1) {
+    atomic_store(&tree_busy, false);
+    return true;
+  }
+  atomic_store(&node_count, 0);
+  memset(node_table, 0, sizeof(node_table));
+  bool created = false;
+  MctsNode *root_node = find_node(root.state.hash, true, &created);
+
+  SearchWorker workers[MAX_SEARCH_THREADS];
+  size_t thread_count = search_threads;
+#ifndef _WIN32
+  pthread_t threads[MAX_SEARCH_THREADS];
+  size_t started = 1;
+#endif
+  for (size_t i = 0; i < thread_count; i++)
+    workers[i] = (SearchWorker){&root, root_node,
+                                root.seed + i * 0x9E3779B97F4A7C15ull, 0};
+#ifndef _WIN32
+  while (started < thread_count &&
+         pthread_create(&threads[started], NULL, run_search,
+                        &workers[started]) == 0)
+    started += 1;
+  thread_count = started;
+#else
+  // No search threads on Windows
+  thread_count = 1;
+#endif
+  run_search(&workers[0]);
+#ifndef _WIN32
+  for (size_t i = 1; i < thread_count; i++)
+    pthread_join(threads[i], NULL);
+#endif
+
+  // Most visited action at the root
+  uint64_t iterations = 0;
+  for (size_t i = 0; i < thread_count; i++)
+    iterations += workers[i].iterations;
+  *action = CfrCall;
+  uint32_t most_visits = 0;
+  for (size_t i = 0; i < CFR_ACTION_COUNT; i++) {
+    if (!is_action_legal(&root.state.hand, i))
+      continue;
+    SearchState child = root.state;
+    step(&child, i);
+    MctsNode *node = find_node(child.hash, false, &created);
+    uint32_t visits = node == NULL ? 0 : atomic_load(&node->visits);
+    if (visits > most_visits) {
+      most_visits = visits;
+      *action = i;
+    }
+  }
+  metric_add(MetricMctsIterations, iterations);
+  uint32_t used = atomic_load(&node_count);
+  metric_add(MetricMctsNodes, used < MCTS_NODES ? used : MCTS_NODES);
+  atomic_store(&tree_busy, false);
+  return true;
+}
@@ -0,0 +1,30 @@
+#ifndef MCTS_H
+#define MCTS_H
+#include "bot.h"
+#include "cfr.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Monte Carlo tree search over the rest of the hand. Each iteration deals the
+// cards this seat can not see at random (determinization) and plays down the
+// tree, picking actions by UCB, then checks the hand down to the showdown.
+// Betting follows the simplified turn order of rules.h and the abstract
+// actions of cfr.h.
+//
+// Nodes are keyed by a Zobrist hash of the public state, updated
+// incrementally with each action, so lines that reach the same state share
+// one node. Nodes come from a fixed arena and are found through an open
+// addressing transposition table, both reset for every search. Several
+// threads search the same tree, and a node on a thread's path counts as a
+// loss until that thread backs up its result (virtual loss), so the threads
+// spread over different lines.
+
+// Search threads used per decision, including the calling thread
+void set_mcts_threads(size_t count);
+// Search until `deadline`, in metrics_now() nanoseconds, and return the most
+// visited action at the root. Returns false without searching if another
+// search is using the tree
+bool search_mcts(const BotView *view, uint64_t deadline, CfrAction *action);
+
+#endif
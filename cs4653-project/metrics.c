@@ -0,0 +1,321 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+// Seconds between rewrites of the metrics file
+#define METRICS_FILE_INTERVAL 5
+// Room for the HELP, TYPE and sample lines of one metric, with the names and
+// help kept short. The derived evaluator metric takes one more
+#define METRIC_TEXT_SIZE 256
+#define METRICS_BUFFER_SIZE ((METRIC_COUNT + 1) * METRIC_TEXT_SIZE)
+
+typedef enum {
+  Counter,
+  Gauge,
+} MetricType;
+
+static const struct {
+  const char *name;
+  const char *help;
+  MetricType type;
+} METRIC_INFO[METRIC_COUNT] = {
+    [MetricGameEvents] = {"holdem_game_events_total",
+                          "Game events processed by tick_game", Counter},
+    [MetricGameQueueDepth] = {"holdem_game_queue_depth",
+                              "Events waiting in the game event queue", Gauge},
+    [MetricGameQueueHighWater] = {"holdem_game_queue_high_water",
+                                  "Most events ever in the game event queue",
+                                  Gauge},
+    [MetricAnimEvents] = {"holdem_anim_events_total",
+                          "Animation events processed by draw", Counter},
+    [MetricAnimQueueDepth] = {"holdem_anim_queue_depth",
+                              "Events waiting in the animation queue", Gauge},
+    [MetricAnimQueueHighWater] = {"holdem_anim_queue_high_water",
+                                  "Most events ever in the animation queue",
+                                  Gauge},
+    [MetricEvaluatorCalls] = {"holdem_evaluator_calls_total",
+                              "Hands evaluated", Counter},
+    [MetricEvaluatorNanoseconds] = {"holdem_evaluator_nanoseconds_total",
+                                    "Time spent evaluating hands", Counter},
+    [MetricHandsPlayed] = {"holdem_hands_played_total",
+                           "Hands played to showdown", Counter},
+    [MetricFramesRendered] = {"holdem_frames_rendered_total",
+                              "Frames that re-rendered the table canvas",
+                              Counter},
+    [MetricFramesSkipped] = {"holdem_frames_skipped_total",
+                             "Frames that reused the cached table canvas",
+                             Counter},
+    [MetricStrengthCacheHits] = {"holdem_strength_cache_hits_total",
+                                 "Hand strength lookups served from the cache",
+                                 Counter},
+    [MetricStrengthCacheMisses] = {"holdem_strength_cache_misses_total",
+                                   "Hand strength lookups that were computed",
+                                   Counter},
+    [MetricStrengthNanoseconds] = {"holdem_strength_nanoseconds_total",
+                                   "Time spent computing hand strength",
+                                   Counter},
+    [MetricBotDecisions] = {"holdem_bot_decisions_total", "Bot decisions made",
+                            Counter},
+    [MetricBotDecisionNanoseconds] = {"holdem_bot_decision_nanoseconds_total",
+                                      "Time spent on bot decisions", Counter},
+    [MetricBotDecisionMaxNanoseconds] = {
+        "holdem_bot_decision_max_nanoseconds", "Slowest bot decision", Gauge},
+    [MetricBotBudgetExpired] = {"holdem_bot_budget_expired_total",
+                                "Bot decisions cut short by their time budget",
+                                Counter},
+    [MetricBotDecisionsCancelled] = {"holdem_bot_decisions_cancelled_total",
+                                     "Bot decisions abandoned when the hand "
+                                     "ended",
+                                     Counter},
+    [MetricBotPendingFrames] = {"holdem_bot_pending_frames_total",
+                                "Frames spent waiting on a bot decision",
+                                Counter},
+    [MetricMctsIterations] = {"holdem_mcts_iterations_total",
+                              "Playouts run by the tree search", Counter},
+    [MetricMctsNodes] = {"holdem_mcts_nodes_total",
+                         "Tree nodes created by the tree search", Counter},
+    [MetricHistoryHands] = {"holdem_history_hands_total",
+                            "Hands written to the hand history", Counter},
+    [MetricHistoryDropped] = {"holdem_history_dropped_total",
+                              "Hands dropped because the history writer "
+                              "fell behind",
+                              Counter},
+    [MetricHistoryBytes] = {"holdem_history_bytes_total",
+                            "Bytes written to the hand history file", Counter},
+    [MetricReplayMismatches] = {"holdem_replay_mismatches_total",
+                                "Replayed hands that played out differently "
+                                "from the history",
+                                Counter},
+    [MetricJournalEntries] = {"holdem_journal_entries_total",
+                              "Events and actions appended to the journal",
+                              Counter},
+    [MetricJournalCommits] = {"holdem_journal_commits_total",
+                              "Group commits of the journal", Counter},
+};
+
+static atomic_int_fast64_t metric_values[METRIC_COUNT] = {};
+
+void metric_add(Metric metric, int64_t amount) {
+  atomic_fetch_add_explicit(&metric_values[metric], amount,
+                            memory_order_relaxed);
+}
+
+void metric_set(Metric metric, int64_t value) {
+  atomic_store_explicit(&metric_values[metric], value, memory_order_relaxed);
+}
+
+void metric_max(Metric metric, int64_t value) {
+  int_fast64_t current =
+      atomic_load_explicit(&metric_values[metric], memory_order_relaxed);
+  while (current < value &&
+         !atomic_compare_exchange_weak_explicit(&metric_values[metric],
+                                                &current, value,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+}
+
+int64_t metric_get(Metric metric) {
+  return atomic_load_explicit(&metric_values[metric], memory_order_relaxed);
+}
+
+// Monotonic where there is one, so a clock change never makes time go back
+uint64_t metrics_now() {
+  struct timespec ts;
+#ifndef _WIN32
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  timespec_get(&ts, TIME_UTC);
+#endif
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Append to the buffer, or leave it as it was if the text does not fit
+bool append_metric(char *buffer, size_t size, size_t *length,
+                   const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(buffer + *length, size - *length, format, args);
+  va_end(args);
+  if (written < 0 || (size_t)written >= size - *length) {
+    buffer[*length] = '\0';
+    return false;
+  }
+  *length += written;
+  return true;
+}
+
+size_t format_metrics(char *buffer, size_t size) {
+  size_t length = 0;
+  if (size == 0)
+    return 0;
+  buffer[0] = '\0';
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    if (!append_metric(buffer, size, &length,
+                       "# HELP %s %s\n# TYPE %s %s\n%s %lld\n",
+                       METRIC_INFO[i].name, METRIC_INFO[i].help,
+                       METRIC_INFO[i].name,
+                       METRIC_INFO[i].type == Counter ? "counter" : "gauge",
+                       METRIC_INFO[i].name, (long long)metric_get(i)))
+      return length;
+  }
+  // Derived from the evaluator counters
+  int64_t calls = metric_get(MetricEvaluatorCalls);
+  double ns_per_call =
+      calls > 0 ? (double)metric_get(MetricEvaluatorNanoseconds) / calls : 0;
+  append_metric(buffer, size, &length,
+                "# HELP holdem_evaluator_ns_per_call Average time per "
+                "hand evaluation\n"
+                "# TYPE holdem_evaluator_ns_per_call gauge\n"
+                "holdem_evaluator_ns_per_call %.1f\n",
+                ns_per_call);
+  return length;
+}
+
+#ifndef _WIN32
+static pthread_t exporter_thread;
+static bool exporter_running = false;
+static atomic_bool exporter_stop = false;
+static int listen_socket = -1;
+static const char *metrics_file = NULL;
+
+// Write to a temporary file and rename it, so readers never see a partial file
+void write_metrics_file() {
+  char buffer[METRICS_BUFFER_SIZE];
+  char temp_path[512];
+  size_t length = format_metrics(buffer, sizeof(buffer));
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", metrics_file);
+  FILE *file = fopen(temp_path, "w");
+  if (file == NULL)
+    return;
+  fwrite(buffer, 1, length, file);
+  fclose(file);
+  rename(temp_path, metrics_file);
+}
+
+// Send all of it, without raising SIGPIPE if the client has gone, which
+// would kill the game
+bool send_all(int client, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(client, data, length, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    data += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+void serve_metrics_request(int client) {
+  char request[1024];
+  // The request itself is ignored, every path returns the metrics
+  if (read(client, request, sizeof(request)) <= 0)
+    return;
+  char body[METRICS_BUFFER_SIZE];
+  char header[256];
+  size_t body_length = format_metrics(body, sizeof(body));
+  int header_length =
+      snprintf(header, sizeof(header),
+               "HTTP/1.0 200 OK\r\n"
+               "Content-Type: text/plain; version=0.0.4\r\n"
+               "Content-Length: %zu\r\n"
+               "Connection: close\r\n\r\n",
+               body_length);
+  if (send_all(client, header, header_length))
+    send_all(client, body, body_length);
+}
+
+void *run_metrics_exporter(void *arg) {
+  time_t last_write = 0;
+  while (!atomic_load(&exporter_stop)) {
+    if (metrics_file != NULL &&
+        time(NULL) - last_write >= METRICS_FILE_INTERVAL) {
+      write_metrics_file();
+      last_write = time(NULL);
+    }
+    if (listen_socket < 0) {
+      sleep(1);
+      continue;
+    }
+    struct pollfd fd = {.fd = listen_socket, .events = POLLIN};
+    if (poll(&fd, 1, 1000) <= 0)
+      continue;
+    int client = accept(listen_socket, NULL, NULL);
+    if (client < 0)
+      continue;
+    // Do not let a slow client stall the exporter
+    struct timeval timeout = {.tv_sec = 1};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    serve_metrics_request(client);
+    close(client);
+  }
+  if (metrics_file != NULL)
+    write_metrics_file();
+  return NULL;
+}
+
+int open_listen_socket(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  // Only listen on loopback
+  struct sockaddr_in address = {.sin_family = AF_INET,
+                                .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(fd, 8) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void start_metrics_exporter() {
+  char *port = getenv("HOLDEM_METRICS_PORT");
+  metrics_file = getenv("HOLDEM_METRICS_FILE");
+  if (port != NULL) {
+    listen_socket = open_listen_socket(atoi(port));
+    if (listen_socket < 0)
+      printf("Could not listen for metrics on port %s\n", port);
+  }
+  if (listen_socket < 0 && metrics_file == NULL)
+    return;
+  atomic_store(&exporter_stop, false);
+  exporter_running =
+      pthread_create(&exporter_thread, NULL, run_metrics_exporter, NULL) == 0;
+}
+
+void stop_metrics_exporter() {
+  if (!exporter_running)
+    return;
+  atomic_store(&exporter_stop, true);
+  pthread_join(exporter_thread, NULL);
+  exporter_running = false;
+  if (listen_socket >= 0)
+    close(listen_socket);
+  listen_socket = -1;
+}
+#else
+// Exporting is not supported on Windows, metrics can still be read in-process
+void start_metrics_exporter() {}
+void stop_metrics_exporter() {}
+#endif
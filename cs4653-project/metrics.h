@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdint.h>
+#include <stddef.h>
+
+// Runtime metrics. Values are lock-free atomics that can be updated from any
+// thread, and are exported in the Prometheus text format
+typedef enum {
+  MetricGameEvents,
+  MetricGameQueueDepth,
+  MetricGameQueueHighWater,
+  MetricAnimEvents,
+  MetricAnimQueueDepth,
+  MetricAnimQueueHighWater,
+  MetricEvaluatorCalls,
+  MetricEvaluatorNanoseconds,
+  MetricHandsPlayed,
+  MetricFramesRendered,
+  MetricFramesSkipped,
+  MetricStrengthCacheHits,
+  MetricStrengthCacheMisses,
+  MetricStrengthNanoseconds,
+  MetricBotDecisions,
+  MetricBotDecisionNanoseconds,
+  MetricBotDecisionMaxNanoseconds,
+  MetricBotBudgetExpired,
+  MetricBotDecisionsCancelled,
+  MetricBotPendingFrames,
+  MetricMctsIterations,
+  MetricMctsNodes,
+  MetricHistoryHands,
+  MetricHistoryDropped,
+  MetricHistoryBytes,
+  MetricReplayMismatches,
+  MetricJournalEntries,
+  MetricJournalCommits,
+  METRIC_COUNT,
+} Metric;
+
+void metric_add(Metric metric, int64_t amount);
+void metric_set(Metric metric, int64_t value);
+// Raise the metric to `value` if it is lower
+void metric_max(Metric metric, int64_t value);
+int64_t metric_get(Metric metric);
+// Nanoseconds since an arbitrary fixed point, for timing metrics
+uint64_t metrics_now();
+// Write all metrics in the Prometheus text format, returns the length written.
+// Metrics that do not fit in `size` are left out whole, never cut mid-line
+size_t format_metrics(char *buffer, size_t size);
+// Start exporting metrics on a background thread, configured by environment:
+// HOLDEM_METRICS_PORT serves them over HTTP on 127.0.0.1:<port>
+// HOLDEM_METRICS_FILE rewrites them to <path> every few seconds
+void start_metrics_exporter();
+void stop_metrics_exporter();
+
+#endif
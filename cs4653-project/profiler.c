@@ -0,0 +1,145 @@
+#include "profiler.h"
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "tick", "animation", "canvas", "blit", "ui", "present", "frame",
+};
+
+// Ring buffers of per-frame stage times in milliseconds, all indexed by the
+// current frame
+static float stage_times[STAGE_COUNT][PROFILE_HISTORY] = {};
+static double stage_start[STAGE_COUNT] = {};
+static size_t current_frame = 0;
+static double frame_start = 0;
+static bool overlay_visible = false;
+// Sorted copy of each stage's times, so the overlay sorts every stage once
+// in PROFILE_REFRESH_FRAMES frames instead of for every percentile drawn
+static float sorted_times[STAGE_COUNT][PROFILE_HISTORY] = {};
+static size_t sorted_counts[STAGE_COUNT] = {};
+static size_t sorted_frames[STAGE_COUNT] = {};
+static bool sorted_ready[STAGE_COUNT] = {};
+
+void profile_begin(ProfileStage stage) { stage_start[stage] = GetTime(); }
+
+void profile_end(ProfileStage stage) {
+  stage_times[stage][current_frame % PROFILE_HISTORY] +=
+      (GetTime() - stage_start[stage]) * 1000.0;
+}
+
+void profile_next_frame() {
+  double now = GetTime();
+  if (frame_start != 0) {
+    stage_times[StageFrame][current_frame % PROFILE_HISTORY] =
+        (now - frame_start) * 1000.0;
+    current_frame += 1;
+  }
+  frame_start = now;
+  for (int i = 0; i < STAGE_COUNT; i++)
+    stage_times[i][current_frame % PROFILE_HISTORY] = 0;
+}
+
+int compare_floats(const void *a, const void *b) {
+  float x = *(const float *)a;
+  float y = *(const float *)b;
+  return (x > y) - (x < y);
+}
+
+// Number of finished frames in the ring buffers
+size_t get_profile_sample_count() {
+  if (current_frame < PROFILE_HISTORY)
+    return current_frame;
+  return PROFILE_HISTORY - 1;
+}
+
+void sort_stage_times(ProfileStage stage) {
+  size_t count = get_profile_sample_count();
+  float *sorted = sorted_times[stage];
+  // Skip the slot of the frame still being recorded
+  size_t current_slot = current_frame % PROFILE_HISTORY;
+  size_t n = 0;
+  for (size_t i = 0; i < PROFILE_HISTORY && n < count; i++) {
+    if (i != current_slot)
+      sorted[n++] = stage_times[stage][i];
+  }
+  qsort(sorted, n, sizeof(float), compare_floats);
+  sorted_counts[stage] = n;
+  sorted_frames[stage] = current_frame;
+  sorted_ready[stage] = true;
+}
+
+float get_profile_percentile(ProfileStage stage, float percentile) {
+  if (!sorted_ready[stage] ||
+      current_frame - sorted_frames[stage] >= PROFILE_REFRESH_FRAMES)
+    sort_stage_times(stage);
+  size_t n = sorted_counts[stage];
+  if (n == 0)
+    return 0;
+  size_t index = (size_t)(percentile / 100.0 * (n - 1) + 0.5);
+  return sorted_times[stage][index];
+}
+
+void draw_profiler() {
+  if (IsKeyPressed(KEY_F3))
+    overlay_visible = !overlay_visible;
+  if (!overlay_visible)
+    return;
+  const int x = 10;
+  const int y = 10;
+  const int line_height = 12;
+  const int graph_height = 60;
+  const float graph_max_ms = 50.0;
+  int width = PROFILE_HISTORY + 20;
+  int height = (STAGE_COUNT + 1) * line_height + graph_height + 30;
+  DrawRectangle(x, y, width, height, Fade(BLACK, 0.75));
+  // Percentile table
+  DrawText("stage        p50 ms   p95 ms   p99 ms", x + 10, y + 10, 10,
+           WHITE);
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    DrawText(TextFormat("%-10s %8.2f %8.2f %8.2f", STAGE_NAMES[i],
+                        get_profile_percentile(i, 50),
+                        get_profile_percentile(i, 95),
+                        get_profile_percentile(i, 99)),
+             x + 10, y + 10 + (i + 1) * line_height, 10, WHITE);
+  }
+  // Frame time graph, oldest frame on the left
+  int graph_bottom = y + height - 10;
+  size_t count = get_profile_sample_count();
+  for (size_t i = 0; i < count; i++) {
+    size_t frame = current_frame - count + i;
+    float ms = stage_times[StageFrame][frame % PROFILE_HISTORY];
+    int bar = (int)(ms / graph_max_ms * graph_height);
+    if (bar > graph_height)
+      bar = graph_height;
+    Color color = GREEN;
+    if (ms > 1000.0 / 30.0)
+      color = RED;
+    else if (ms > 1000.0 / 60.0)
+      color = YELLOW;
+    DrawLine(x + 10 + i, graph_bottom, x + 10 + i, graph_bottom - bar, color);
+  }
+  // 60 FPS budget line
+  int budget_y =
+      graph_bottom - (int)(1000.0 / 60.0 / graph_max_ms * graph_height);
+  DrawLine(x + 10, budget_y, x + 10 + PROFILE_HISTORY, budget_y, GRAY);
+}
+
+bool dump_profile_csv(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return false;
+  fprintf(file, "stage,samples,p50_ms,p95_ms,p99_ms,max_ms\n");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    sort_stage_times(i);
+    fprintf(file, "%s,%zu,%.4f,%.4f,%.4f,%.4f\n", STAGE_NAMES[i],
+            get_profile_sample_count(), get_profile_percentile(i, 50),
+            get_profile_percentile(i, 95), get_profile_percentile(i, 99),
+            get_profile_percentile(i, 100));
+  }
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <stdbool.h>
+
+// Number of frames of timings kept for each stage
+#define PROFILE_HISTORY 512
+// Frames between sorts of a stage's times for its percentiles
+#define PROFILE_REFRESH_FRAMES 30
+
+// Stages of a frame that are timed separately
+typedef enum {
+  StageTick,
+  StageAnimation,
+  StageCanvas,
+  StageBlit,
+  StageUi,
+  StagePresent,
+  // Time between the start of consecutive frames
+  StageFrame,
+  STAGE_COUNT,
+} ProfileStage;
+
+// Time the code between a begin/end pair, adding to the stage's time for the
+// current frame
+void profile_begin(ProfileStage stage);
+void profile_end(ProfileStage stage);
+// Start recording the next frame
+void profile_next_frame();
+// Percentile (0-100) of a stage's recorded times in milliseconds, up to
+// PROFILE_REFRESH_FRAMES frames out of date
+float get_profile_percentile(ProfileStage stage, float percentile);
+// Draw the profiler overlay if it is toggled on (F3)
+void draw_profiler();
+// Write the per-stage percentiles to a CSV file
+bool dump_profile_csv(const char *path);
+
+#endif
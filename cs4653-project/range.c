@@ -0,0 +1,192 @@
+#include "range.h"
+#include "holdem_eval.h"
+#include "subsets.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Ranks in range notation run from Two to ACE_RANK, aces high
+#define ACE_RANK (King + 1)
+
+typedef enum { AnySuited, Suited, Offsuit } Suitedness;
+
+// A group of hands like "AKs", with `high` >= `low`
+typedef struct {
+  int high;
+  int low;
+  Suitedness suitedness;
+} HandClass;
+
+static const Suite SUITES[4] = {Club, Spade, Diamond, Heart};
+
+uint64_t card_mask(Card card) { return 1ull << card_index(card); }
+
+int parse_rank(char c) {
+  switch (c) {
+  case 'A':
+  case 'a':
+    return ACE_RANK;
+  case 'K':
+  case 'k':
+    return King;
+  case 'Q':
+  case 'q':
+    return Queen;
+  case 'J':
+  case 'j':
+    return Jack;
+  case 'T':
+  case 't':
+    return Ten;
+  default:
+    if (c < '2' || c > '9')
+      return 0;
+    return c - '0';
+  }
+}
+
+Card rank_card(int rank, Suite suite) {
+  return new_card(rank == ACE_RANK ? Ace : rank, suite);
+}
+
+void add_combo(Range *range, Card a, Card b) {
+  uint64_t mask = card_mask(a) | card_mask(b);
+  uint64_t rank = rank_subset(mask);
+  if (range->present[rank / 64] & (1ull << rank % 64))
+    return;
+  range->present[rank / 64] |= 1ull << rank % 64;
+  range->combos[range->count++] = (Combo){{a, b}, mask};
+}
+
+void add_hand_class(Range *range, HandClass hand) {
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      if (hand.high == hand.low && j <= i)
+        continue;
+      if (hand.suitedness == Suited && i != j)
+        continue;
+      if (hand.suitedness == Offsuit && i == j)
+        continue;
+      add_combo(range, rank_card(hand.high, SUITES[i]),
+                rank_card(hand.low, SUITES[j]));
+    }
+  }
+}
+
+// Parse a hand class like "AK", "AKs" or "QQ" from the start of `text`.
+// Returns the number of characters read, or 0 if it is not valid
+size_t parse_hand_class(const char *text, size_t length, HandClass *hand) {
+  if (length < 2)
+    return 0;
+  int first = parse_rank(text[0]);
+  int second = parse_rank(text[1]);
+  if (first == 0 || second == 0)
+    return 0;
+  hand->high = first > second ? first : second;
+  hand->low = first > second ? second : first;
+  hand->suitedness = AnySuited;
+  if (length > 2 && (text[2] == 's' || text[2] == 'o')) {
+    // Pairs can not be suited, and are always offsuit
+    if (hand->high == hand->low)
+      return 0;
+    hand->suitedness = text[2] == 's' ? Suited : Offsuit;
+    return 3;
+  }
+  return 2;
+}
+
+bool parse_range_entry(const char *text, size_t length, Range *range) {
+  // Exact cards
+  int16_t cards[2];
+  if (length == 4 && holdem_eval_parse_card(text, &cards[0]) == 2 &&
+      holdem_eval_parse_card(text + 2, &cards[1]) == 2) {
+    if (cards[0] == cards[1])
+      return false;
+    add_combo(range, cards[0], cards[1]);
+    return true;
+  }
+
+  HandClass hand;
+  size_t read = parse_hand_class(text, length, &hand);
+  if (read == 0)
+    return false;
+  if (read == length) {
+    add_hand_class(range, hand);
+    return true;
+  }
+
+  if (text[read] == '+' && read + 1 == length) {
+    if (hand.high == hand.low) {
+      for (; hand.high <= ACE_RANK; hand.high++) {
+        hand.low = hand.high;
+        add_hand_class(range, hand);
+      }
+    } else {
+      for (; hand.low < hand.high; hand.low++)
+        add_hand_class(range, hand);
+    }
+    return true;
+  }
+
+  HandClass last;
+  if (text[read] != '-' ||
+      parse_hand_class(text + read + 1, length - read - 1, &last) !=
+          length - read - 1 ||
+      last.suitedness != hand.suitedness)
+    return false;
+  // Walk from the lower hand up to the higher one
+  if (last.high > hand.high || last.low > hand.low) {
+    HandClass temp = hand;
+    hand = last;
+    last = temp;
+  }
+  if (hand.high == hand.low && last.high == last.low) {
+    // Pairs, "99-66"
+    for (int rank = last.high; rank <= hand.high; rank++)
+      add_hand_class(range, (HandClass){rank, rank, AnySuited});
+  } else if (hand.high == last.high) {
+    // Fixed high card, "A5s-A2s"
+    for (int low = last.low; low <= hand.low; low++)
+      add_hand_class(range, (HandClass){hand.high, low, hand.suitedness});
+  } else if (hand.high - hand.low == last.high - last.low) {
+    // Same gap, "T9s-76s"
+    int gap = hand.high - hand.low;
+    for (int high = last.high; high <= hand.high; high++)
+      add_hand_class(range, (HandClass){high, high - gap, hand.suitedness});
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parse_range(const char *text, Range *range) {
+  range->count = 0;
+  memset(range->present, 0, sizeof(range->present));
+  while (*text != '\0') {
+    while (*text == ' ' || *text == ',')
+      text++;
+    size_t length = 0;
+    while (text[length] != '\0' && text[length] != ',' && text[length] != ' ')
+      length++;
+    if (length == 0)
+      break;
+    if (!parse_range_entry(text, length, range))
+      return false;
+    text += length;
+  }
+  return range->count > 0;
+}
+
+void remove_dead_cards(Range *range, uint64_t dead) {
+  size_t kept = 0;
+  for (size_t i = 0; i < range->count; i++) {
+    uint64_t mask = range->combos[i].mask;
+    if ((mask & dead) == 0) {
+      range->combos[kept++] = range->combos[i];
+    } else {
+      uint64_t rank = rank_subset(mask);
+      range->present[rank / 64] &= ~(1ull << rank % 64);
+    }
+  }
+  range->count = kept;
+}
@@ -0,0 +1,35 @@
+#ifndef RANGE_H
+#define RANGE_H
+#include "cards.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of distinct pairs of hole cards
+#define MAX_COMBOS 1326
+
+// Two hole cards, and the same cards as a mask of card_index() bits
+typedef struct {
+  Card cards[2];
+  uint64_t mask;
+} Combo;
+
+// Hand range expanded into its combos, with no combo repeated
+typedef struct {
+  Combo combos[MAX_COMBOS];
+  size_t count;
+  // Combos in the range, a bit for each by rank_subset() of its mask
+  uint64_t present[(MAX_COMBOS + 63) / 64];
+} Range;
+
+uint64_t card_mask(Card card);
+// Parse comma separated range notation into `range`. Entries can be a pair
+// ("QQ"), suited or offsuit hands ("AKs", "AKo", or "AK" for both), a plus
+// for everything above ("QQ+", "ATs+"), a dash between two hands ("T9s-76s",
+// "A5s-A2s", "99-66"), or exact cards ("AhKd"). Returns false if any entry is
+// not valid
+bool parse_range(const char *text, Range *range);
+// Remove combos that use any card in `dead`
+void remove_dead_cards(Range *range, uint64_t dead);
+
+#endif
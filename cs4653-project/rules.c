@@ -0,0 +1,83 @@
+#include "rules.h"
+#include <string.h>
+
+int32_t get_max_bet(const TableState *table) {
+  int32_t max_bet = 0;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    if (table->current_bets[i] > max_bet)
+      max_bet = table->current_bets[i];
+  }
+  return max_bet;
+}
+
+int32_t resolve_call(const TableState *table, size_t seat) {
+  int32_t amount_to_call = get_max_bet(table) - table->current_bets[seat];
+  if (amount_to_call > table->money[seat] || table->folded[seat])
+    return FOLD_CHIPS;
+  return amount_to_call;
+}
+
+int32_t resolve_bet(const TableState *table, size_t seat, int32_t amount) {
+  int32_t chips = resolve_call(table, seat);
+  if (chips == FOLD_CHIPS)
+    return FOLD_CHIPS;
+  TableState called = *table;
+  apply_chips(&called, seat, chips);
+  // Prevent betting more than poorest player still in the game
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    int32_t amount_to_call =
+        called.money[POT] + amount - called.current_bets[i];
+    if (amount_to_call > called.money[i] && !called.folded[i])
+      amount = called.money[i];
+  }
+  if (amount > 0)
+    chips += amount;
+  return chips;
+}
+
+void apply_chips(TableState *table, size_t seat, int32_t chips) {
+  if (chips == FOLD_CHIPS) {
+    table->folded[seat] = true;
+    return;
+  }
+  table->money[seat] -= chips;
+  table->current_bets[seat] += chips;
+  table->money[POT] += chips;
+}
+
+size_t count_in_hand(const TableState *table) {
+  size_t count = 0;
+  for (size_t i = 0; i < SEAT_COUNT; i++)
+    count += !table->folded[i];
+  return count;
+}
+
+bool advance_hand(HandState *state) {
+  while (count_in_hand(&state->table) > 1) {
+    state->seat += 1;
+    if (state->seat == SEAT_COUNT) {
+      // End of a pass, go around again while someone is short of the bet
+      int32_t max_bet = get_max_bet(&state->table);
+      bool settled = true;
+      for (size_t i = 0; i < SEAT_COUNT; i++)
+        settled &= state->table.folded[i] ||
+                   state->table.current_bets[i] == max_bet;
+      if (settled) {
+        if (state->street + 1 == STREET_COUNT)
+          return false;
+        state->street += 1;
+        state->bet_made = false;
+        memset(state->table.current_bets, 0,
+               sizeof(state->table.current_bets));
+      }
+      state->seat = 0;
+    }
+    if (state->table.folded[state->seat])
+      continue;
+    // After the bet, seats that are not short of it have nothing to decide
+    if (state->bet_made && resolve_call(&state->table, state->seat) == 0)
+      continue;
+    return true;
+  }
+  return false;
+}
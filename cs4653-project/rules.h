@@ -0,0 +1,55 @@
+#ifndef RULES_H
+#define RULES_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Betting rules. The game applies them to its own table through the
+// integrity monitor, the offline solver applies them to copies of a table
+// while it walks the game tree.
+
+#define SEAT_COUNT 4
+// Wallet index of the pot
+#define POT SEAT_COUNT
+// Returned instead of a chip count when an action folds the seat
+#define FOLD_CHIPS -1
+
+typedef struct {
+  // Money of each seat, then the pot
+  int32_t money[SEAT_COUNT + 1];
+  int32_t current_bets[SEAT_COUNT];
+  bool folded[SEAT_COUNT];
+} TableState;
+
+int32_t get_max_bet(const TableState *table);
+// Chips `seat` puts in to call, or FOLD_CHIPS if it can not cover the call
+int32_t resolve_call(const TableState *table, size_t seat);
+// Chips `seat` puts in to raise by `amount`: the call and then the raise.
+// The raise is capped to the money of the poorest player still in the hand,
+// which prevents split pots
+int32_t resolve_bet(const TableState *table, size_t seat, int32_t amount);
+// Fold the seat if `chips` is FOLD_CHIPS, otherwise move the chips from its
+// money into its bet and the pot
+void apply_chips(TableState *table, size_t seat, int32_t chips);
+// Seats that have not folded
+size_t count_in_hand(const TableState *table);
+
+// Betting of a whole hand in the simplified turn order that the solver and
+// the search bots simulate: seats act in order, each street allows one bet,
+// and the seats short of the bet get one more turn to call or fold.
+#define STREET_COUNT 4
+typedef struct {
+  TableState table;
+  // 0 before the flop to 3 on the river
+  size_t street;
+  // Seat to act, SIZE_MAX before the first turn of the hand
+  size_t seat;
+  // Whether the one bet of this street has been made
+  bool bet_made;
+} HandState;
+
+// Move on to the next seat that has a decision to make. Returns false once
+// the betting is over, because one seat is left or the river is done
+bool advance_hand(HandState *state);
+
+#endif
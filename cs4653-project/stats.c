@@ -0,0 +1,156 @@
+#include "stats.h"
+#include <string.h>
+
+// What a seat did in one hand
+#define PLAYED_VPIP (1 << 0)
+#define PLAYED_PFR (1 << 1)
+#define PLAYED_SHOWDOWN (1 << 2)
+#define PLAYED_WON (1 << 3)
+
+// Counters, one array per counter indexed by seat
+typedef struct {
+  uint32_t hands[SEAT_COUNT];
+  uint32_t vpip[SEAT_COUNT];
+  uint32_t pfr[SEAT_COUNT];
+  uint32_t bets[SEAT_COUNT];
+  uint32_t calls[SEAT_COUNT];
+  uint32_t folds[SEAT_COUNT];
+  uint32_t showdowns[SEAT_COUNT];
+  uint32_t showdowns_won[SEAT_COUNT];
+} Counters;
+
+static Counters session = {};
+static Counters recent = {};
+// The hand in progress
+static uint8_t hand_flags[SEAT_COUNT] = {};
+static uint8_t hand_bets[SEAT_COUNT] = {};
+static uint8_t hand_calls[SEAT_COUNT] = {};
+static uint8_t hand_folds[SEAT_COUNT] = {};
+// Ring buffer of the hands in the rolling window
+static uint8_t ring_flags[STATS_WINDOW][SEAT_COUNT] = {};
+static uint8_t ring_bets[STATS_WINDOW][SEAT_COUNT] = {};
+static uint8_t ring_calls[STATS_WINDOW][SEAT_COUNT] = {};
+static uint8_t ring_folds[STATS_WINDOW][SEAT_COUNT] = {};
+static size_t ring_next = 0;
+static size_t ring_count = 0;
+static uint32_t version = 0;
+
+void reset_stats() {
+  memset(&session, 0, sizeof(session));
+  memset(&recent, 0, sizeof(recent));
+  ring_next = ring_count = 0;
+  stats_hand_started();
+}
+
+void stats_hand_started() {
+  memset(hand_flags, 0, sizeof(hand_flags));
+  memset(hand_bets, 0, sizeof(hand_bets));
+  memset(hand_calls, 0, sizeof(hand_calls));
+  memset(hand_folds, 0, sizeof(hand_folds));
+  version += 1;
+}
+
+// Per-hand action counts saturate rather than wrap
+void count_action(uint8_t *counts, size_t seat) {
+  if (counts[seat] < UINT8_MAX)
+    counts[seat] += 1;
+}
+
+void stats_bet(size_t seat, bool preflop) {
+  count_action(hand_bets, seat);
+  if (preflop)
+    hand_flags[seat] |= PLAYED_VPIP | PLAYED_PFR;
+  version += 1;
+}
+
+void stats_call(size_t seat, int32_t chips, bool preflop) {
+  // Checks are not calls
+  if (chips <= 0)
+    return;
+  count_action(hand_calls, seat);
+  if (preflop)
+    hand_flags[seat] |= PLAYED_VPIP;
+  version += 1;
+}
+
+void stats_fold(size_t seat) {
+  count_action(hand_folds, seat);
+  version += 1;
+}
+
+// Add (sign 1) or remove (sign -1) one seat's hand from a set of counters
+void add_hand(Counters *counters, size_t seat, int sign, uint8_t flags,
+              uint8_t bets, uint8_t calls, uint8_t folds) {
+  counters->hands[seat] += sign;
+  counters->vpip[seat] += sign * !!(flags & PLAYED_VPIP);
+  counters->pfr[seat] += sign * !!(flags & PLAYED_PFR);
+  counters->showdowns[seat] += sign * !!(flags & PLAYED_SHOWDOWN);
+  counters->showdowns_won[seat] += sign * !!(flags & PLAYED_WON);
+  counters->bets[seat] += sign * bets;
+  counters->calls[seat] += sign * calls;
+  counters->folds[seat] += sign * folds;
+}
+
+void stats_payout(size_t winner, const bool folded[SEAT_COUNT]) {
+  size_t in_hand = 0;
+  for (size_t i = 0; i < SEAT_COUNT; i++)
+    in_hand += !folded[i];
+  // With one seat left there was no showdown
+  if (in_hand > 1) {
+    for (size_t i = 0; i < SEAT_COUNT; i++) {
+      if (!folded[i])
+        hand_flags[i] |= PLAYED_SHOWDOWN;
+    }
+    hand_flags[winner] |= PLAYED_WON;
+  }
+  // The hand leaving the window makes room for this one
+  size_t slot = ring_next;
+  for (size_t i = 0; i < SEAT_COUNT; i++) {
+    if (ring_count == STATS_WINDOW)
+      add_hand(&recent, i, -1, ring_flags[slot][i], ring_bets[slot][i],
+               ring_calls[slot][i], ring_folds[slot][i]);
+    add_hand(&recent, i, 1, hand_flags[i], hand_bets[i], hand_calls[i],
+             hand_folds[i]);
+    add_hand(&session, i, 1, hand_flags[i], hand_bets[i], hand_calls[i],
+             hand_folds[i]);
+  }
+  memcpy(ring_flags[slot], hand_flags, sizeof(hand_flags));
+  memcpy(ring_bets[slot], hand_bets, sizeof(hand_bets));
+  memcpy(ring_calls[slot], hand_calls, sizeof(hand_calls));
+  memcpy(ring_folds[slot], hand_folds, sizeof(hand_folds));
+  ring_next = (ring_next + 1) % STATS_WINDOW;
+  if (ring_count < STATS_WINDOW)
+    ring_count += 1;
+  stats_hand_started();
+}
+
+float share(uint32_t count, uint32_t total) {
+  return total == 0 ? 0.0 : (float)count / total;
+}
+
+SeatStats read_counters(const Counters *counters, size_t seat) {
+  SeatStats stats = {};
+  uint32_t hands = counters->hands[seat];
+  uint32_t actions =
+      counters->bets[seat] + counters->calls[seat] + counters->folds[seat];
+  stats.hands = hands;
+  stats.vpip = share(counters->vpip[seat], hands);
+  stats.pfr = share(counters->pfr[seat], hands);
+  // Without any calls, every bet counts fully
+  stats.aggression = counters->calls[seat] == 0
+                         ? counters->bets[seat]
+                         : share(counters->bets[seat], counters->calls[seat]);
+  stats.fold_rate = share(counters->folds[seat], actions);
+  stats.showdown = share(counters->showdowns[seat], hands);
+  stats.showdown_won =
+      share(counters->showdowns_won[seat], counters->showdowns[seat]);
+  return stats;
+}
+
+SeatStats get_seat_stats(size_t seat) { return read_counters(&session, seat); }
+
+SeatStats get_recent_seat_stats(size_t seat) {
+  return read_counters(&recent, seat);
+}
+
+uint32_t get_stats_version() { return version; }
@@ -0,0 +1,46 @@
+#ifndef STATS_H
+#define STATS_H
+#include "rules.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Opponent statistics. The game reports every bet, call, fold and payout,
+// and per-seat counters are updated in place, so reading a statistic is a
+// division and never a scan of past hands. Counters are kept for the whole
+// session and for a rolling window of the last STATS_WINDOW hands.
+
+#define STATS_WINDOW 100
+
+typedef struct {
+  // Share of hands the seat put money in voluntarily before the flop
+  float vpip;
+  // Share of hands the seat raised before the flop
+  float pfr;
+  // Bets and raises per call, on every street
+  float aggression;
+  // Share of its actions that were folds
+  float fold_rate;
+  // Share of hands the seat was still in at the showdown, and of those
+  // showdowns the share it won
+  float showdown;
+  float showdown_won;
+  uint32_t hands;
+} SeatStats;
+
+void reset_stats();
+void stats_hand_started();
+// A bet that raised, or a call of `chips` (0 for a check)
+void stats_bet(size_t seat, bool preflop);
+void stats_call(size_t seat, int32_t chips, bool preflop);
+void stats_fold(size_t seat);
+// The pot went to `winner`. Ends the hand, `folded` tells which seats were
+// still in it
+void stats_payout(size_t winner, const bool folded[SEAT_COUNT]);
+// Statistics over the whole session, or over the last STATS_WINDOW hands
+SeatStats get_seat_stats(size_t seat);
+SeatStats get_recent_seat_stats(size_t seat);
+// Changes whenever any statistic does
+uint32_t get_stats_version();
+
+#endif
@@ -0,0 +1,330 @@
+#include "strength.h"
+#include "canonical.h"
+#include "metrics.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runouts sampled for preflop strength
+#define PREFLOP_SAMPLES 2000
+// Samples for an estimate when there is no time to compute the strength,
+// and how many are drawn between checks of the clock
+#define ESTIMATE_SAMPLES 1000
+#define SAMPLE_BATCH 16
+// The cache is split into shards with their own lock, so threads looking up
+// different hands rarely wait on each other
+#define STRENGTH_SHARDS 64
+#define SHARD_SLOTS 1024
+// Slots searched past the home slot before an entry is overwritten
+#define PROBE_LIMIT 8
+
+typedef enum { Ahead, Tied, Behind } Standing;
+
+// Opponent hands by standing now, and by standing now and after the next card
+typedef struct {
+  double standings[3];
+  double potentials[3][3];
+  double potential_totals[3];
+} StrengthTally;
+
+typedef struct {
+  // 0 for an empty slot, canonical keys are never 0
+  uint64_t key;
+  HandStrength strength;
+} StrengthEntry;
+
+typedef struct {
+  atomic_bool locked;
+  StrengthEntry entries[SHARD_SLOTS];
+} StrengthShard;
+
+static StrengthShard shards[STRENGTH_SHARDS] = {};
+
+// Nanoseconds the last computation for each board size took, to tell whether
+// one fits in a decision's budget. Start from typical costs
+static atomic_uint_fast64_t compute_costs[6] = {
+    1000000, 0, 0, 5000000, 5000000, 200000};
+
+void lock_shard(StrengthShard *shard) {
+  while (atomic_exchange_explicit(&shard->locked, true, memory_order_acquire))
+    ;
+}
+
+void unlock_shard(StrengthShard *shard) {
+  atomic_store_explicit(&shard->locked, false, memory_order_release);
+}
+
+Standing compare_values(HandValue ours, HandValue theirs) {
+  if (ours > theirs)
+    return Ahead;
+  if (ours == theirs)
+    return Tied;
+  return Behind;
+}
+
+// xorshift64
+uint64_t next_strength_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+HandStrength finish_strength(const StrengthTally *tally) {
+  double total = tally->standings[Ahead] + tally->standings[Tied] +
+                 tally->standings[Behind];
+  // Nothing sampled, even odds
+  if (total == 0)
+    return (HandStrength){0.5, 0.0, 0.0, 0.5};
+  float strength = (tally->standings[Ahead] + tally->standings[Tied] / 2) /
+                   total;
+  float positive = 0.0;
+  float negative = 0.0;
+  const double(*potentials)[3] = tally->potentials;
+  double behind =
+      tally->potential_totals[Behind] + tally->potential_totals[Tied] / 2;
+  if (behind > 0)
+    positive = (potentials[Behind][Ahead] + potentials[Behind][Tied] / 2 +
+                potentials[Tied][Ahead] / 2) /
+               behind;
+  double ahead =
+      tally->potential_totals[Ahead] + tally->potential_totals[Tied] / 2;
+  if (ahead > 0)
+    negative = (potentials[Ahead][Behind] + potentials[Ahead][Tied] / 2 +
+                potentials[Tied][Behind] / 2) /
+               ahead;
+  return (HandStrength){strength, positive, negative, strength};
+}
+
+// The strength from random opponent hands, and a random next card for the
+// potentials, instead of all of them. Preflop the whole board is dealt, so
+// the strength is the equity against one random hand. Seeded by the key so
+// the result does not depend on which thread drew the samples. Stops after
+// `samples`, or at the deadline, setting `expired`
+HandStrength sample_strength(const Card hole[2], const Card *board,
+                             size_t board_count, uint64_t key, size_t samples,
+                             uint64_t deadline, bool *expired) {
+  uint64_t used = (1ull << card_index(hole[0])) | (1ull << card_index(hole[1]));
+  Card ours[7] = {hole[0], hole[1]};
+  Card theirs[7] = {};
+  for (size_t i = 0; i < board_count; i++) {
+    ours[i + 2] = theirs[i + 2] = board[i];
+    used |= 1ull << card_index(board[i]);
+  }
+  Card deck[CARD_COUNT];
+  size_t deck_count = 0;
+  for (int i = 0; i < CARD_COUNT; i++) {
+    if (!(used & (1ull << i)))
+      deck[deck_count++] = index_card(i);
+  }
+  size_t count = board_count + 2;
+  bool preflop = board_count == 0;
+  bool lookahead = board_count > 0 && board_count < 5;
+  // Two opponent cards, then the rest of the board or the next card
+  size_t dealt = preflop ? 7 : lookahead ? 3 : 2;
+  HandValue our_value = preflop ? 0 : evaluate_cards(ours, count);
+  uint64_t state = key * 0x9E3779B97F4A7C15ull | 1;
+  StrengthTally tally = {};
+  for (size_t sample = 0; sample < samples; sample++) {
+    if (sample % SAMPLE_BATCH == 0 && metrics_now() >= deadline) {
+      *expired = true;
+      break;
+    }
+    // Partial shuffle
+    for (size_t i = 0; i < dealt; i++) {
+      size_t j = i + next_strength_random(&state) % (deck_count - i);
+      Card temp = deck[i];
+      deck[i] = deck[j];
+      deck[j] = temp;
+    }
+    theirs[0] = deck[0];
+    theirs[1] = deck[1];
+    if (preflop) {
+      for (size_t i = 2; i < 7; i++)
+        ours[i] = theirs[i] = deck[i];
+      tally.standings[compare_values(evaluate_cards(ours, 7),
+                                     evaluate_cards(theirs, 7))] += 1;
+      continue;
+    }
+    Standing now = compare_values(our_value, evaluate_cards(theirs, count));
+    tally.standings[now] += 1;
+    if (!lookahead)
+      continue;
+    ours[count] = theirs[count] = deck[2];
+    Standing later = compare_values(evaluate_cards(ours, count + 1),
+                                    evaluate_cards(theirs, count + 1));
+    tally.potentials[now][later] += 1;
+    tally.potential_totals[now] += 1;
+  }
+  return finish_strength(&tally);
+}
+
+// Enumerate every opponent hand, and every next card for the potentials
+HandStrength compute_strength(const Card hole[2], const Card *board,
+                              size_t board_count) {
+  uint64_t used = (1ull << card_index(hole[0])) | (1ull << card_index(hole[1]));
+  Card ours[7] = {hole[0], hole[1]};
+  Card theirs[7] = {};
+  for (size_t i = 0; i < board_count; i++) {
+    ours[i + 2] = theirs[i + 2] = board[i];
+    used |= 1ull << card_index(board[i]);
+  }
+  Card deck[CARD_COUNT];
+  size_t deck_count = 0;
+  for (int i = 0; i < CARD_COUNT; i++) {
+    if (!(used & (1ull << i)))
+      deck[deck_count++] = index_card(i);
+  }
+  size_t count = board_count + 2;
+  HandValue our_value = evaluate_cards(ours, count);
+  bool lookahead = board_count < 5;
+  // Our value with each possible next card
+  HandValue our_next[CARD_COUNT];
+  if (lookahead) {
+    for (size_t i = 0; i < deck_count; i++) {
+      ours[count] = deck[i];
+      our_next[i] = evaluate_cards(ours, count + 1);
+    }
+  }
+
+  StrengthTally tally = {};
+  for (size_t a = 0; a < deck_count; a++) {
+    for (size_t b = a + 1; b < deck_count; b++) {
+      theirs[0] = deck[a];
+      theirs[1] = deck[b];
+      Standing now = compare_values(our_value, evaluate_cards(theirs, count));
+      tally.standings[now] += 1;
+      if (!lookahead)
+        continue;
+      for (size_t c = 0; c < deck_count; c++) {
+        if (c == a || c == b)
+          continue;
+        theirs[count] = deck[c];
+        Standing later =
+            compare_values(our_next[c], evaluate_cards(theirs, count + 1));
+        tally.potentials[now][later] += 1;
+        tally.potential_totals[now] += 1;
+      }
+    }
+  }
+  return finish_strength(&tally);
+}
+
+// Shard and home slot of a key
+StrengthShard *find_shard(uint64_t key, size_t *home) {
+  uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+  *home = (hash >> 20) % SHARD_SLOTS;
+  return &shards[hash >> 58];
+}
+
+bool lookup_strength(uint64_t key, HandStrength *result) {
+  size_t home;
+  StrengthShard *shard = find_shard(key, &home);
+  bool found = false;
+  lock_shard(shard);
+  for (size_t i = 0; i < PROBE_LIMIT; i++) {
+    StrengthEntry *entry = &shard->entries[(home + i) % SHARD_SLOTS];
+    if (entry->key == key) {
+      *result = entry->strength;
+      found = true;
+      break;
+    }
+    if (entry->key == 0)
+      break;
+  }
+  unlock_shard(shard);
+  return found;
+}
+
+// Take the first free slot, or overwrite the home slot if there is none
+void store_strength(uint64_t key, HandStrength strength) {
+  size_t home;
+  StrengthShard *shard = find_shard(key, &home);
+  lock_shard(shard);
+  StrengthEntry *slot = &shard->entries[home];
+  for (size_t i = 0; i < PROBE_LIMIT; i++) {
+    StrengthEntry *entry = &shard->entries[(home + i) % SHARD_SLOTS];
+    if (entry->key == 0 || entry->key == key) {
+      slot = entry;
+      break;
+    }
+  }
+  *slot = (StrengthEntry){key, strength};
+  unlock_shard(shard);
+}
+
+// Cached results are against one opponent. To stay ahead of several random
+// hands we have to be ahead of each of them
+HandStrength against_opponents(HandStrength result, size_t opponents) {
+  if (opponents > 1)
+    result.strength = powf(result.strength, opponents);
+  result.effective_strength =
+      result.strength * (1.0 - result.negative_potential) +
+      (1.0 - result.strength) * result.positive_potential;
+  return result;
+}
+
+HandStrength get_hand_strength(const Card hole[2], const Card *board,
+                               size_t board_count, size_t opponents) {
+  uint64_t key = canonical_key(hole, board, board_count);
+  HandStrength result;
+  if (lookup_strength(key, &result)) {
+    metric_add(MetricStrengthCacheHits, 1);
+    return against_opponents(result, opponents);
+  }
+  uint64_t start = metrics_now();
+  bool expired = false;
+  if (board_count == 0)
+    result = sample_strength(hole, NULL, 0, key, PREFLOP_SAMPLES, UINT64_MAX,
+                             &expired);
+  else
+    result = compute_strength(hole, board, board_count);
+  uint64_t cost = metrics_now() - start;
+  atomic_store(&compute_costs[board_count], cost);
+  metric_add(MetricStrengthNanoseconds, cost);
+  metric_add(MetricStrengthCacheMisses, 1);
+  store_strength(key, result);
+  return against_opponents(result, opponents);
+}
+
+// A cached result, or one computed and cached if that should be done by the
+// deadline. Returns false without computing anything if it would not be
+bool get_hand_strength_by(const Card hole[2], const Card *board,
+                          size_t board_count, size_t opponents,
+                          uint64_t deadline, HandStrength *strength) {
+  uint64_t key = canonical_key(hole, board, board_count);
+  if (lookup_strength(key, strength)) {
+    metric_add(MetricStrengthCacheHits, 1);
+    *strength = against_opponents(*strength, opponents);
+    return true;
+  }
+  uint64_t now = metrics_now();
+  uint64_t cost = atomic_load(&compute_costs[board_count]);
+  if (now >= deadline || deadline - now < cost)
+    return false;
+  *strength = get_hand_strength(hole, board, board_count, opponents);
+  return true;
+}
+
+HandStrength estimate_hand_strength(const Card hole[2], const Card *board,
+                                    size_t board_count, size_t opponents,
+                                    uint64_t deadline, bool *expired) {
+  HandStrength strength;
+  if (get_hand_strength_by(hole, board, board_count, opponents, deadline,
+                           &strength))
+    return strength;
+  uint64_t key = canonical_key(hole, board, board_count);
+  strength = sample_strength(hole, board, board_count, key, ESTIMATE_SAMPLES,
+                             deadline, expired);
+  return against_opponents(strength, opponents);
+}
+
+void clear_hand_strength_cache() {
+  for (size_t i = 0; i < STRENGTH_SHARDS; i++) {
+    lock_shard(&shards[i]);
+    for (size_t j = 0; j < SHARD_SLOTS; j++)
+      shards[i].entries[j].key = 0;
+    unlock_shard(&shards[i]);
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef STRENGTH_H
+#define STRENGTH_H
+#include "cards.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hand strength and hand potential, after Billings et al. Strength is the
+// chance of being ahead of random hands right now, positive potential the
+// chance of getting ahead with the next card when behind, negative potential
+// the chance of falling behind when ahead. Effective hand strength combines
+// them. Before the flop there is no potential and strength is the equity
+// against random hands, sampled.
+typedef struct {
+  float strength;
+  float positive_potential;
+  float negative_potential;
+  float effective_strength;
+} HandStrength;
+
+// Strength of `hole` on a board of `board_count` cards (0, 3, 4 or 5) against
+// `opponents` random hands. Results are cached by the suit-canonical hand, so
+// repeat queries cost a table lookup. Safe to call from any thread
+HandStrength get_hand_strength(const Card hole[2], const Card *board,
+                               size_t board_count, size_t opponents);
+// Like get_hand_strength(), but done by `deadline`, in metrics_now()
+// nanoseconds. A result that is not cached is only computed if there is time
+// for it, otherwise it is estimated from samples until the deadline, which
+// sets `expired` if it cuts the sampling short
+HandStrength estimate_hand_strength(const Card hole[2], const Card *board,
+                                    size_t board_count, size_t opponents,
+                                    uint64_t deadline, bool *expired);
+// Drop every cached result
+void clear_hand_strength_cache();
+
+#endif
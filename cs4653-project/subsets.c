@@ -0,0 +1,99 @@
+#include "subsets.h"
+#include <stdint.h>
+
+// binomials[n][k] is C(n, k). Constant, so it needs no setup and any thread
+// can read it at any time
+static const uint64_t binomials[CARD_COUNT + 1][MAX_SUBSET_CARDS + 1] = {
+    {1, 0, 0, 0, 0, 0, 0, 0},
+    {1, 1, 0, 0, 0, 0, 0, 0},
+    {1, 2, 1, 0, 0, 0, 0, 0},
+    {1, 3, 3, 1, 0, 0, 0, 0},
+    {1, 4, 6, 4, 1, 0, 0, 0},
+    {1, 5, 10, 10, 5, 1, 0, 0},
+    {1, 6, 15, 20, 15, 6, 1, 0},
+    {1, 7, 21, 35, 35, 21, 7, 1},
+    {1, 8, 28, 56, 70, 56, 28, 8},
+    {1, 9, 36, 84, 126, 126, 84, 36},
+    {1, 10, 45, 120, 210, 252, 210, 120},
+    {1, 11, 55, 165, 330, 462, 462, 330},
+    {1, 12, 66, 220, 495, 792, 924, 792},
+    {1, 13, 78, 286, 715, 1287, 1716, 1716},
+    {1, 14, 91, 364, 1001, 2002, 3003, 3432},
+    {1, 15, 105, 455, 1365, 3003, 5005, 6435},
+    {1, 16, 120, 560, 1820, 4368, 8008, 11440},
+    {1, 17, 136, 680, 2380, 6188, 12376, 19448},
+    {1, 18, 153, 816, 3060, 8568, 18564, 31824},
+    {1, 19, 171, 969, 3876, 11628, 27132, 50388},
+    {1, 20, 190, 1140, 4845, 15504, 38760, 77520},
+    {1, 21, 210, 1330, 5985, 20349, 54264, 116280},
+    {1, 22, 231, 1540, 7315, 26334, 74613, 170544},
+    {1, 23, 253, 1771, 8855, 33649, 100947, 245157},
+    {1, 24, 276, 2024, 10626, 42504, 134596, 346104},
+    {1, 25, 300, 2300, 12650, 53130, 177100, 480700},
+    {1, 26, 325, 2600, 14950, 65780, 230230, 657800},
+    {1, 27, 351, 2925, 17550, 80730, 296010, 888030},
+    {1, 28, 378, 3276, 20475, 98280, 376740, 1184040},
+    {1, 29, 406, 3654, 23751, 118755, 475020, 1560780},
+    {1, 30, 435, 4060, 27405, 142506, 593775, 2035800},
+    {1, 31, 465, 4495, 31465, 169911, 736281, 2629575},
+    {1, 32, 496, 4960, 35960, 201376, 906192, 3365856},
+    {1, 33, 528, 5456, 40920, 237336, 1107568, 4272048},
+    {1, 34, 561, 5984, 46376, 278256, 1344904, 5379616},
+    {1, 35, 595, 6545, 52360, 324632, 1623160, 6724520},
+    {1, 36, 630, 7140, 58905, 376992, 1947792, 8347680},
+    {1, 37, 666, 7770, 66045, 435897, 2324784, 10295472},
+    {1, 38, 703, 8436, 73815, 501942, 2760681, 12620256},
+    {1, 39, 741, 9139, 82251, 575757, 3262623, 15380937},
+    {1, 40, 780, 9880, 91390, 658008, 3838380, 18643560},
+    {1, 41, 820, 10660, 101270, 749398, 4496388, 22481940},
+    {1, 42, 861, 11480, 111930, 850668, 5245786, 26978328},
+    {1, 43, 903, 12341, 123410, 962598, 6096454, 32224114},
+    {1, 44, 946, 13244, 135751, 1086008, 7059052, 38320568},
+    {1, 45, 990, 14190, 148995, 1221759, 8145060, 45379620},
+    {1, 46, 1035, 15180, 163185, 1370754, 9366819, 53524680},
+    {1, 47, 1081, 16215, 178365, 1533939, 10737573, 62891499},
+    {1, 48, 1128, 17296, 194580, 1712304, 12271512, 73629072},
+    {1, 49, 1176, 18424, 211876, 1906884, 13983816, 85900584},
+    {1, 50, 1225, 19600, 230300, 2118760, 15890700, 99884400},
+    {1, 51, 1275, 20825, 249900, 2349060, 18009460, 115775100},
+    {1, 52, 1326, 22100, 270725, 2598960, 20358520, 133784560},
+};
+
+uint64_t subset_count(size_t k) { return binomials[CARD_COUNT][k]; }
+
+// Index of the lowest set bit of a non-zero mask
+size_t lowest_card(uint64_t mask) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(mask);
+#else
+  size_t index = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    index++;
+  }
+  return index;
+#endif
+}
+
+uint64_t rank_subset(uint64_t mask) {
+  uint64_t rank = 0;
+  for (size_t k = 1; mask != 0 && k <= MAX_SUBSET_CARDS; k++) {
+    rank += binomials[lowest_card(mask)][k];
+    mask &= mask - 1;
+  }
+  return rank;
+}
+
+uint64_t unrank_subset(uint64_t rank, size_t k) {
+  uint64_t mask = 0;
+  // Take the highest card first: the largest c with C(c, k) <= rank
+  size_t card = CARD_COUNT;
+  for (; k > 0; k--) {
+    do {
+      card--;
+    } while (binomials[card][k] > rank);
+    rank -= binomials[card][k];
+    mask |= 1ull << card;
+  }
+  return mask;
+}
@@ -0,0 +1,23 @@
+#ifndef SUBSETS_H
+#define SUBSETS_H
+#include "cards.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Combinatorial number system for sets of cards. A set of k cards, as a mask
+// of card_index() bits, has a dense rank in [0, C(52, k)), so per-hand data
+// can live in flat arrays indexed by rank. Ranks are in colex order: the
+// rank of cards c1 < c2 < ... < ck is C(c1, 1) + C(c2, 2) + ... + C(ck, k).
+// Safe to call from any thread.
+
+// Largest set that can be ranked
+#define MAX_SUBSET_CARDS 7
+
+// Number of sets of `k` cards, C(52, k)
+uint64_t subset_count(size_t k);
+// Rank of the set of cards in `mask`, which holds at most MAX_SUBSET_CARDS
+uint64_t rank_subset(uint64_t mask);
+// Set of `k` cards with the given rank, as a mask
+uint64_t unrank_subset(uint64_t rank, size_t k);
+
+#endif
@@ -0,0 +1,63 @@
+#include "canonical.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Checks that the canonical indices split the starting hands and flops into
+// exactly as many classes as there are up to suit isomorphism. Run with
+// `make check`.
+
+static bool seen[CANONICAL_FLOP_COUNT];
+
+// Count an index the first time it is seen. Out of range indices are never
+// counted, so they show up as missing classes
+size_t mark_class(size_t index, size_t classes) {
+  if (index >= classes || seen[index])
+    return 0;
+  seen[index] = true;
+  return 1;
+}
+
+// Cards are passed out of order, the index must not depend on it
+size_t count_hole_classes() {
+  size_t distinct = 0;
+  for (int a = 0; a < CARD_COUNT; a++) {
+    for (int b = a + 1; b < CARD_COUNT; b++) {
+      Card hole[2] = {index_card(b), index_card(a)};
+      distinct += mark_class(canonical_hole_index(hole), CANONICAL_HOLE_COUNT);
+    }
+  }
+  return distinct;
+}
+
+size_t count_flop_classes() {
+  size_t distinct = 0;
+  for (int a = 0; a < CARD_COUNT; a++) {
+    for (int b = a + 1; b < CARD_COUNT; b++) {
+      for (int c = b + 1; c < CARD_COUNT; c++) {
+        Card flop[3] = {index_card(c), index_card(a), index_card(b)};
+        distinct +=
+            mark_class(canonical_flop_index(flop), CANONICAL_FLOP_COUNT);
+      }
+    }
+  }
+  return distinct;
+}
+
+int run_check(const char *name, size_t (*count_classes)(), size_t expected) {
+  for (size_t i = 0; i < CANONICAL_FLOP_COUNT; i++)
+    seen[i] = false;
+  size_t classes = count_classes();
+  int passed = classes == expected;
+  printf("%s %s: %zu classes, expected %zu\n", passed ? "ok  " : "FAIL", name,
+         classes, expected);
+  return passed;
+}
+
+int main(void) {
+  size_t failed = 0;
+  failed += !run_check("starting hands", count_hole_classes,
+                       CANONICAL_HOLE_COUNT);
+  failed += !run_check("flops", count_flop_classes, CANONICAL_FLOP_COUNT);
+  printf("%zu of 2 class checks failed\n", failed);
+  return failed != 0;
+}
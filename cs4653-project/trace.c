@@ -0,0 +1,143 @@
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Number of events in each buffer chunk
+#define TRACE_CHUNK_SIZE 16384
+
+typedef struct {
+  const char *name;
+  const char *category;
+  uint64_t start;
+  uint64_t duration;
+  const char *arg_names[2];
+  int64_t arg_values[2];
+} TraceEvent;
+
+// Buffers are chunked so recording never copies or reallocates events
+typedef struct TraceChunk {
+  TraceEvent events[TRACE_CHUNK_SIZE];
+  size_t count;
+  struct TraceChunk *next;
+} TraceChunk;
+
+// One buffer per recording thread, linked into a global list when the thread
+// records its first event
+typedef struct TraceBuffer {
+  size_t thread_id;
+  TraceChunk *first;
+  TraceChunk *last;
+  struct TraceBuffer *next;
+} TraceBuffer;
+
+atomic_bool trace_enabled = false;
+static const char *trace_path = NULL;
+static _Atomic(TraceBuffer *) trace_buffers = NULL;
+static atomic_size_t trace_thread_count = 0;
+static _Thread_local TraceBuffer *thread_buffer = NULL;
+
+void init_trace(const char *path) {
+  trace_path = path;
+  trace_enabled = true;
+}
+
+// The same clock as metrics_now()
+uint64_t trace_now() {
+  struct timespec ts;
+#ifndef _WIN32
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  timespec_get(&ts, TIME_UTC);
+#endif
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+TraceBuffer *get_thread_buffer() {
+  if (thread_buffer != NULL)
+    return thread_buffer;
+  TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+  if (buffer == NULL)
+    return NULL;
+  buffer->thread_id = atomic_fetch_add(&trace_thread_count, 1) + 1;
+  // Lock-free push onto the global buffer list
+  buffer->next = atomic_load(&trace_buffers);
+  while (!atomic_compare_exchange_weak(&trace_buffers, &buffer->next, buffer))
+    ;
+  thread_buffer = buffer;
+  return buffer;
+}
+
+void trace_span(const char *name, const char *category, uint64_t start,
+                uint64_t end, const char *arg0_name, int64_t arg0,
+                const char *arg1_name, int64_t arg1) {
+  if (!trace_enabled)
+    return;
+  TraceBuffer *buffer = get_thread_buffer();
+  if (buffer == NULL)
+    return;
+  if (buffer->last == NULL || buffer->last->count == TRACE_CHUNK_SIZE) {
+    TraceChunk *chunk = malloc(sizeof(TraceChunk));
+    if (chunk == NULL)
+      return;
+    chunk->count = 0;
+    chunk->next = NULL;
+    if (buffer->last == NULL)
+      buffer->first = chunk;
+    else
+      buffer->last->next = chunk;
+    buffer->last = chunk;
+  }
+  buffer->last->events[buffer->last->count++] = (TraceEvent){
+      .name = name,
+      .category = category,
+      .start = start,
+      .duration = end > start ? end - start : 0,
+      .arg_names = {arg0_name, arg1_name},
+      .arg_values = {arg0, arg1},
+  };
+}
+
+void flush_trace() {
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+  FILE *file = fopen(trace_path, "w");
+  if (file == NULL) {
+    printf("Could not write trace to %s\n", trace_path);
+    return;
+  }
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  TraceBuffer *buffer = atomic_load(&trace_buffers);
+  for (; buffer != NULL; buffer = buffer->next) {
+    for (TraceChunk *chunk = buffer->first; chunk != NULL;
+         chunk = chunk->next) {
+      for (size_t i = 0; i < chunk->count; i++) {
+        TraceEvent *ev = &chunk->events[i];
+        fprintf(file,
+                "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                "\"tid\":%zu,\"ts\":%llu,\"dur\":%llu,\"args\":{",
+                first ? "" : ",\n", ev->name, ev->category, buffer->thread_id,
+                (unsigned long long)ev->start,
+                (unsigned long long)ev->duration);
+        int arg_count = 0;
+        for (int j = 0; j < 2; j++) {
+          if (ev->arg_names[j] == NULL)
+            continue;
+          fprintf(file, "%s\"%s\":%lld", arg_count > 0 ? "," : "",
+                  ev->arg_names[j], (long long)ev->arg_values[j]);
+          arg_count += 1;
+        }
+        fprintf(file, "}}");
+        first = false;
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+}
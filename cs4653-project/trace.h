@@ -0,0 +1,25 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Opt-in Chrome/Perfetto trace-event recorder. Events are appended to a
+// buffer owned by the recording thread and written as trace-event JSON when
+// the trace is flushed. trace_enabled is read by every recording thread.
+extern atomic_bool trace_enabled;
+
+// Start recording, the trace will be written to `path` on flush_trace()
+void init_trace(const char *path);
+// Microseconds since an arbitrary fixed point
+uint64_t trace_now();
+// Record a span from `start` to `end` with up to two named integer arguments
+// (use NULL names for unused arguments). Names must be string literals.
+void trace_span(const char *name, const char *category, uint64_t start,
+                uint64_t end, const char *arg0_name, int64_t arg0,
+                const char *arg1_name, int64_t arg1);
+// Write all recorded events, should be called once all recording threads
+// have finished
+void flush_trace();
+
+#endif